@@ -1,870 +1,6655 @@
-/*
- * @author: Ryan Chen, rwc6613@rit.edu
- */
-
-// inventory.c file
-#include "inventory.h"
-
-#define MAX_LINE_LENGTH 256
-
-inventory_t inv = {.part_list = NULL, .part_count = 0, .assembly_list = NULL, .assembly_count = 0};
-
-void add_part(inventory_t * invp, char * id){
-        struct part * current = invp->part_list;
-
-        // checking for invalid ID
-        if (id[0] != 'P'){
-                fprintf(stderr, "!!! %s: part ID must start with 'P'\n", id);
-                return;
-        }
-        if (strlen(id) > ID_MAX){
-                fprintf(stderr, "!!! %s: part ID too long\n", id);
-                return;
-        }
-
-        // checking for duplicate ID
-        part_t * part_lookup_pointer = lookup_part(inv.part_list, id);
-        if (part_lookup_pointer != NULL){
-                fprintf(stderr, "!!! %s: duplicate part ID\n", id);
-                return;
-        }
-
-        // creating new part
-        struct part * new_part = (struct part *)malloc(sizeof(struct part));
-        // checking for allocation
-        if (new_part == NULL){
-                fprintf(stderr, "!!! Memory allocation failed\n");
-                return;
-        }
-        strcpy(new_part->id, id);
-        new_part->id[ID_MAX] = '\0';
-        new_part->next = NULL;
-
-        if (invp->part_list == NULL){
-                invp->part_list = new_part;
-        }
-        else {
-                current = invp->part_list;
-                while (current->next != NULL){
-                    current = current->next;
-                }
-                current->next = new_part;
-        }
-
-        invp->part_count++;
-}
-
-void add_assembly(inventory_t * invp, char * id, int capacity, items_needed_t * items){
-        assembly_t * current = invp->assembly_list;
-
-        // checking for invalid ID
-        if (id[0] != 'A'){
-                fprintf(stderr, "!!! %s: assembly ID must start with 'A'\n", id);
-                free(items);
-                return;
-        }
-        if (strlen(id) > ID_MAX){
-                fprintf(stderr, "!!! %s: assembly ID too long\n", id);
-                free(items);
-                return;
-        }
-        if (capacity < 0){
-                fprintf(stderr, "!!! %d: illegal capacity for ID %s\n", capacity, id);
-                free(items);
-                return;
-        }
-
-        // checking for duplicate ID
-        assembly_t * assembly_lookup_pointer = lookup_assembly(inv.assembly_list, id);
-        if (assembly_lookup_pointer != NULL){
-                fprintf(stderr, "!!! %s: duplicate assembly ID\n", id);
-                free(items);
-                return;
-        }
-
-        // creating new assembly
-        struct assembly * new_assembly = (struct assembly *)malloc(sizeof(struct assembly));
-
-        // checking for allocation
-        if (new_assembly == NULL){
-                fprintf(stderr, "!!! Memory allocation failed\n");
-                return;
-        }
-        strcpy(new_assembly->id, id);
-        new_assembly->id[ID_MAX] = '\0';
-        new_assembly->capacity = capacity;
-        new_assembly->on_hand = 0;
-        new_assembly->items = items;
-        new_assembly->next = NULL;
-
-        // adding the assembly itself to the inventory
-        if (invp->assembly_list == NULL){
-                invp->assembly_list = new_assembly;
-        }
-        else {
-                current = invp->assembly_list;
-                while (current->next != NULL){
-                        current = current->next;
-                }
-                current->next = new_assembly;
-        }
-
-        invp->assembly_count++;
-}
-
-void add_item(items_needed_t * items, char * id, int quantity){
-        // looking for matching item IDs
-        item_t * item_lookup_pointer = lookup_item(items->item_list, id);
-
-        // if the item was found, aka != NULL, add quantity, otherwise make the new item
-        if (item_lookup_pointer != NULL){
-                item_lookup_pointer->quantity += quantity;
-        }
-        else{
-                // making the new item
-                struct item * new_item = (struct item *)malloc(sizeof(struct item));
-                strcpy(new_item->id, id);
-                new_item->quantity = quantity;
-                new_item->next = NULL;
-
-                // if-else statement is redundant, can reduce it
-                // adding it to the list
-                if (items->item_list == NULL){
-                        items->item_list = new_item;
-                }
-                else{
-                        struct item * current_item = items->item_list;
-                        while (current_item->next != NULL){
-                                current_item = current_item->next;
-                        }
-                        current_item->next = new_item;
-                }
-                items->item_count += 1;
-        }
-}
-
-void fulfillOrder(char * order){
-        items_needed_t * items = calloc(1, sizeof(struct items_needed)); // why calloc calloc is pain
-
-        // main loop for parsing and adding items to item list
-        char * token;
-        token = strtok(order, " ");
-        while (token != NULL){
-                char * ID = token;
-                char * string_quantity = strtok(NULL, " ");
-
-                // checking for valid inputs before continuing
-                if (ID == NULL || string_quantity == NULL){
-                        fprintf(stderr, "!!! Invalid input\n");
-                        free(items);
-                        return;
-                }
-                int quantity = atoi(string_quantity);
-
-                // checking for valid inputs starting with 'A' and valid quantity number, as well as whether the assembly requested exists
-                if (ID[0] != 'A'){
-                        fprintf(stderr, "!!! %s: assembly ID is not in the inventory -- order canceled\n", ID);
-                        free(items);
-                        return;
-                }
-
-                assembly_t * assembly_lookup_pointer = lookup_assembly(inv.assembly_list, ID);
-                if (assembly_lookup_pointer == NULL){
-                        fprintf(stderr, "!!! %s: assembly ID is not in the inventory -- order canceled\n", ID);
-                        free(items);
-                        return;
-                }
-
-                if (quantity <= 0){
-                        fprintf(stderr, "!!! %d: illegal order quantity for ID %s -- order canceled\n", quantity, ID);
-                        free(items);
-                        return;
-                }
-
-                add_item(items, ID, quantity);
-
-                token = strtok(NULL, " ");
-        }
-
-        struct items_needed * parts = calloc(1, sizeof(struct items_needed));
-
-        // getting and maintaining list for parts requested
-        struct item * current_item = items->item_list;
-        while (current_item != NULL){
-                get(&inv, current_item->id, current_item->quantity, parts);
-                current_item = current_item->next;
-        }
-
-        // freeing 'items'
-        current_item = items->item_list;
-        while (current_item != NULL){
-                struct item * temp = current_item;
-                current_item = current_item->next;
-                free(temp);
-        }
-        free(items);
-
-        // printing 'parts'
-        if (parts->item_count > 0){
-                printf("Parts needed:\n");
-                printf("-------------\n");
-                printf("Part ID     quantity\n");
-                printf("=========== ========\n");
-                item_t ** item_array = to_item_array(parts->item_count, parts->item_list);
-                qsort(item_array, parts->item_count, sizeof(item_t *), item_compare); // make the item_compare function
-
-                for (int i = 0; i < parts->item_count; i++){
-                        printf("%-11s %8d\n", item_array[i]->id, item_array[i]->quantity);
-                }
-
-                free(item_array);
-        }
-        // freeing 'parts'
-        current_item = parts->item_list;
-        while (current_item != NULL){
-                struct item * temp = current_item;
-                current_item = current_item->next;
-                free(temp);
-        }
-        free(parts);
-}
-
-void stock(inventory_t * invp, char *id, int n){
-        // checks
-        if (n <= 0){
-                fprintf(stderr, "!!! %d: illegal quantity for ID %s\n", n, id);
-        }
-
-        assembly_t * current_assembly = lookup_assembly(inv.assembly_list, id);
-
-        // checking for valid id
-        if (current_assembly == NULL){
-                fprintf(stderr, "!!! %s: assembly ID is not in the inventory\n", id);
-                return;
-        }
-
-        // a parts needed list
-        items_needed_t * parts = calloc(1, sizeof(struct items_needed));
-
-        char * current_id = current_assembly->id;
-        int capacity = current_assembly->capacity;
-        int on_hand = current_assembly->on_hand;
-
-        // checking for exceeding maximum capacity; if requested amount results in over capacity, only make enough to capacity
-        int amt_needed = n;
-        if (on_hand + n > capacity){
-                amt_needed = capacity - on_hand;
-        }
-
-        make(invp, current_id, amt_needed, parts);
-        current_assembly->on_hand += amt_needed;
-
-        // printing out the parts needed
-        if (parts->item_count > 0){
-                printf("Parts needed:\n");
-                printf("-------------\n");
-                printf("Part ID     quantity\n");
-                printf("=========== ========\n");
-                item_t ** item_array = to_item_array(parts->item_count, parts->item_list);
-                qsort(item_array, parts->item_count, sizeof(item_t *), item_compare); // make the item_compare function
-
-                for (int i = 0; i < parts->item_count; i++){
-                        printf("%-11s %8d\n", item_array[i]->id, item_array[i]->quantity);
-                }
-        }
-
-        // freeing parts needed list
-        item_t * current_item = parts->item_list;
-        while (current_item != NULL){
-                struct item * temp = current_item;
-                current_item = current_item->next;
-                free(temp);
-        }
-
-
-        free(parts);
-}
-
-void restock(inventory_t * invp, char *id){
-        // a parts needed list
-        items_needed_t * parts = calloc(1, sizeof(struct items_needed));
-
-        if (id == NULL){
-                // turning my list into an array to work from LIFO (last in, first out)
-                assembly_t ** assembly_array = to_assembly_array(inv.assembly_count, inv.assembly_list);
-
-                // iterating through each item LIFO
-                for (int i = inv.assembly_count - 1; i >= 0; i--){
-                        assembly_t * current_assembly;
-                        // checking to ensure pointer isn't NULL
-                        if (assembly_array[i] != NULL){
-                                current_assembly = assembly_array[i];
-                        }
-                        else{
-                                continue;
-                        }
-                        char * current_id = current_assembly->id;
-                        int capacity = current_assembly->capacity;
-                        int on_hand = current_assembly->on_hand;
-
-                        // if there aren't enough of a certain assembly, make it and all it's parts
-                        if (on_hand < capacity / 2 + 1){
-                                int amt_needed = capacity - on_hand;
-                                fprintf(stdout, ">>> restocking assembly %s with %d items\n", current_id, amt_needed);
-                                make(invp, current_id, amt_needed, parts);
-                                current_assembly->on_hand += amt_needed;
-                        }
-                }
-
-                free(assembly_array);
-        }
-        else{
-                assembly_t * current_assembly = lookup_assembly(inv.assembly_list, id);
-                if (current_assembly == NULL){
-                        fprintf(stderr, "!!! %s: assembly ID is not in the inventory\n", id);
-                        free(parts);
-                        return;
-                }
-                char * current_id = current_assembly->id;
-                int capacity = current_assembly->capacity;
-                int on_hand = current_assembly->on_hand;
-
-                if (on_hand < capacity / 2 + 1){
-                        int amt_needed = capacity - on_hand;
-                        make(invp, current_id, amt_needed, parts);
-                        current_assembly->on_hand += amt_needed;
-                        fprintf(stdout, ">>> restocking assembly %s with %d items\n", current_id, amt_needed);
-                }
-        }
-
-        // printing out the parts needed
-        if (parts->item_count > 0){
-                fprintf(stdout, "Parts needed:\n");
-                fprintf(stdout, "-------------\n");
-                fprintf(stdout, "Part ID     quantity\n");
-                fprintf(stdout, "=========== ========\n");
-                item_t ** item_array = to_item_array(parts->item_count, parts->item_list);
-                qsort(item_array, parts->item_count, sizeof(item_t *), item_compare); // make the item_compare function
-
-                for (int i = 0; i < parts->item_count; i++){
-                        printf("%-11s %8d\n", item_array[i]->id, item_array[i]->quantity);
-                }
-
-                free(item_array);
-        }
-        // freeing parts needed list
-        item_t * current_item = parts->item_list;
-        while (current_item != NULL){
-                struct item * temp = current_item;
-                current_item = current_item->next;
-                free(temp);
-        }
-        free(parts);
-}
-
-void empty(char *id){
-        if (id[0] != 'A'){
-                fprintf(stderr, "!!! %s: ID not an assembly\n", id);
-                return;
-        }
-        assembly_t * assembly_lookup_pointer = lookup_assembly(inv.assembly_list, id);
-        if (assembly_lookup_pointer == NULL){
-                fprintf(stderr, "!!! %s: assembly ID is not in the inventory\n", id);
-                return;
-        }
-
-        assembly_lookup_pointer->on_hand = 0;
-}
-
-void inventory(char *id){
-        if (id == NULL){
-                fprintf(stdout, "Assembly inventory:\n");
-                fprintf(stdout, "-------------------\n");
-
-                if (inv.assembly_list == NULL){
-                        fprintf(stdout, "EMPTY INVENTORY\n");
-                }
-                else{
-                        fprintf(stdout, "Assembly ID Capacity On Hand\n");
-                        fprintf(stdout, "=========== ======== =======\n");
-
-                        assembly_t ** assembly_array = to_assembly_array(inv.assembly_count, inv.assembly_list);
-                        qsort(assembly_array, inv.assembly_count, sizeof(assembly_t *), assembly_compare);
-
-                        for (int i = 0; i < inv.assembly_count; i++){
-                                fprintf(stdout, "%-11s %8d %7d", assembly_array[i]->id, assembly_array[i]->capacity, assembly_array[i]->on_hand);
-                                if (assembly_array[i]->on_hand < (assembly_array[i]->capacity / 2) + 1){
-                                        fprintf(stdout, "*\n");
-                                }
-                                else{
-                                        fprintf(stdout, "\n");
-                                }
-                        }
-                        free(assembly_array);
-                }
-        }
-         else{
-                // checking for assembly id existing
-                assembly_t * assembly = lookup_assembly(inv.assembly_list, id);
-
-                if (assembly == NULL){
-                        fprintf(stderr, "!!! %s: part/assembly ID is not in the inventory\n", id);
-                        return;
-                }
-
-                fprintf(stdout, "Assembly ID:  %s\n", id);
-                fprintf(stdout, "bin capacity: %d\n", assembly->capacity);
-                fprintf(stdout, "on-hand:      %d\n", assembly->on_hand);
-
-                item_t * items = assembly->items->item_list;
-                int item_count = assembly->items->item_count;
-
-                if (items != NULL){
-                        item_t ** item_array = to_item_array(item_count, items);
-                        // checking to ensure item list isn't empty before outputting
-
-                        qsort(item_array, item_count, sizeof(item_t*), item_compare);
-                        fprintf(stdout, "Parts list:\n");
-                        fprintf(stdout, "-----------\n");
-                        fprintf(stdout, "Part ID     quantity\n");
-                        fprintf(stdout, "=========== ========\n");
-                        for (int i = 0; i < item_count; i++){
-                                fprintf(stdout, "%-15s %4d\n", item_array[i]->id, item_array[i]->quantity);
-                        }
-                        free(item_array);
-                }
-        }
-}
-
-void parts(){
-        // simply printing out what parts we have
-        fprintf(stdout, "Part inventory:\n");
-        fprintf(stdout, "---------------\n");
-        if (inv.part_count == 0){
-                fprintf(stdout, "NO PARTS\n");
-        }
-        else {
-                part_t ** part_array = to_part_array(inv.part_count, inv.part_list);
-                qsort(part_array, inv.part_count, sizeof(part_t *), part_compare);
-                fprintf(stdout, "Part ID\n");
-                fprintf(stdout, "===========\n");
-                for (int i = 0; i < inv.part_count; i++){
-                        fprintf(stdout, "%s\n", part_array[i]->id);
-                }
-                free(part_array);
-        }
-}
-
-void help(){
-        // copied and pasted from website, all commands
-        fprintf(stdout, "Requests:\n");
-        fprintf(stdout, "    addPart\n");
-        fprintf(stdout, "    addAssembly ID capacity [x1 n1 [x2 n2 ...]]\n");
-        fprintf(stdout, "    fulfillOrder [x1 n1 [x2 n2 ...]]\n");
-        fprintf(stdout, "    stock ID n\n");
-        fprintf(stdout, "    restock [ID]\n");
-        fprintf(stdout, "    empty ID\n");
-        fprintf(stdout, "    inventory [ID]\n");
-        fprintf(stdout, "    parts\n");
-        fprintf(stdout, "    help\n");
-        fprintf(stdout, "    clear\n");
-        fprintf(stdout, "    quit\n");
-}
-
-void clear(){
-        // clearing parts and resetting count
-        part_t * current_part = inv.part_list;
-        while (current_part != NULL){
-                part_t * temp = current_part;
-                current_part = current_part->next;
-                free(temp);
-        }
-        inv.part_count = 0;
-
-        // clearing assemblies and resetting count
-        assembly_t * current_assembly = inv.assembly_list;
-        while (current_assembly != NULL){
-                assembly_t * temp_assembly = current_assembly;
-                current_assembly = current_assembly->next;
-
-                // freeing items needed list
-                items_needed_t * current_items_needed = temp_assembly->items;
-                item_t * current_item = current_items_needed->item_list;
-                while (current_item != NULL){
-                        item_t * temp_item = current_item;
-                        current_item = current_item->next;
-                        free(temp_item);
-                }
-                free(current_items_needed);
-                free(temp_assembly);
-        }
-        inv.assembly_count = 0;
-}
-
-void quit(){
-        clear();
-        exit(EXIT_SUCCESS);
-}
-
-// things related to manufacturing
-void make(inventory_t * invp, char * id, int n, items_needed_t * parts){
-        // basic checks
-        if (id[0] != 'A'){
-                fprintf(stderr, "!!! %s: assembly ID must start with 'A'\n", id);
-                return;
-        }
-        if (n <= 0){
-                return;
-        }
-
-        // lookup
-        assembly_t * assembly = lookup_assembly(invp->assembly_list, id);
-        fprintf(stdout, ">>> make %d units of assembly %s\n", n, id);
-
-        // looping through the item's required items
-        item_t ** item_array = to_item_array(assembly->items->item_count, assembly->items->item_list);
-
-        for (int i = assembly->items->item_count - 1; i >= 0; i--){
-                item_t * current_item = item_array[i];
-                char * current_id = current_item->id; // ID of the current item we are looking through
-                int quantity = current_item->quantity; // quantity of the item we need
-
-                if (current_id[0] == 'P'){
-                        add_item(parts, current_id, n * quantity);
-                }
-                else{
-                        get(invp, current_id, n * quantity, parts);
-                }
-                current_item = current_item->next;
-        }
-
-        free(item_array);
-}
-
-void get(inventory_t * invp, char * id, int n, items_needed_t * parts){
-        // basic checks
-        if (id[0] != 'A'){
-                fprintf(stderr, "!!! %s: assembly ID must start with 'A'\n", id);
-                return;
-        }
-        if (n <= 0){
-                return;
-        }
-
-        // lookup
-        assembly_t * assembly = lookup_assembly(invp->assembly_list, id);
-        if (assembly->on_hand >= n){
-                assembly->on_hand -= n;
-        }
-        else{
-                int remaining_quantity = n - assembly->on_hand;
-                make(invp, id, remaining quantity, parts);
-                assembly->on_hand = 0;
-        }
-}
-
-// things related to parts
-part_t ** to_part_array(int count, part_t * part_list){
-        part_t ** part_array = (part_t **)malloc(count * sizeof(part_t *));
-        if (part_array == NULL){
-                fprintf(stderr, "!!! Memory allocation failed\n");
-                return NULL;
-        }
-
-        part_t * current = part_list;
-        for (int i = 0; i < count; i++){
-                part_array[i] = current;
-                current = current->next;
-        }
-        return part_array;
-}
-
-int part_compare(const void * a, const void * b){
-        // need to type-cast the provided parameters to be part_t
-        // need to dereference once to point to the object itself
-        const part_t * p1 = *(const part_t**)a;
-        const part_t * p2 = *(const part_t**)b;
-        return strcmp(p1->id, p2->id);
-}
-
-// things related to assemblies
-assembly_t ** to_assembly_array(int count, assembly_t * assembly_list){
-        assembly_t ** assembly_array = (assembly_t **)malloc(count * sizeof(assembly_t *));
-        if (assembly_array == NULL){
-                fprintf(stderr, "!!! Memory allocation failed\n");
-                return NULL;
-        }
-
-        assembly_t * current = assembly_list;
-        for (int i = 0; i < count; i++){
-                assembly_array[i] = current;
-                current = current->next;
-        }
-        return assembly_array;
-}
-
-int assembly_compare(const void * a, const void * b){
-        const assembly_t * a1 = *(const assembly_t**)a;
-        const assembly_t * a2 = *(const assembly_t**)b;
-        return strcmp(a1->id, a2->id);
-}
-
-// things related to items_needed_t
-item_t ** to_item_array(int count, item_t * item_list){
-        item_t ** item_array = malloc(count * sizeof(item_t *));
-        if (item_array == NULL){
-                fprintf(stderr, "!!! Memory allocation failed\n");
-                return NULL;
-        }
-
-        item_t * current = item_list;
-        for (int i = 0; i < count; i++){
-                item_array[i] = current;
-                current = current->next;
-        }
-        return item_array;
-}
-
-int item_compare(const void * a, const void * b){
-        const item_t * i1 = *(const item_t**)a;
-        const item_t * i2 = *(const item_t**)b;
-        return strcmp(i1->id, i2->id);
-}
-
-// lookup functions
-part_t * lookup_part(part_t * pp, char * id){
-        part_t * pointer;
-        while (pp != NULL){
-                if (strcmp(pp->id, id) == 0){
-                        pointer = pp;
-                        return pointer;
-                }
-                pp = pp->next;
-        }
-        return NULL;
-}
-
-assembly_t * lookup_assembly(assembly_t * ap, char * id){
-        assembly_t * pointer;
-        while (ap != NULL){
-                if (strcmp(ap->id, id) == 0){
-                        pointer = ap;
-                        return pointer;
-                }
-                ap = ap->next;
-        }
-        return NULL;
-}
-
-item_t * lookup_item(item_t * ip, char * id){
-        item_t * pointer;
-        while (ip != NULL){
-                if (strcmp(ip->id, id) == 0){
-                        pointer = ip;
-                        return pointer;
-                }
-                ip = ip->next;
-        }
-        return NULL;
-}
-
-// main function
-int main(int argc, char *argv[]){
-        // checking for correct command line size
-        if (argc > 2){
-                perror("Too many command-line arguments");
-                return EXIT_FAILURE;
-        }
-
-        // file creation, and determining whether program is reading file or standard input
-        FILE *fp;
-
-        if (argc == 2){
-                fp = fopen(argv[1], "r");
-                if(fp == NULL){
-                        perror("Failed to open file");
-                        return EXIT_FAILURE;
-                }
-        }
-        else{
-                fp = stdin;
-        }
-
-        char line[MAX_LINE_LENGTH];
-        while (fgets(line, sizeof(line), fp) != NULL){
-
-                // handling in case there is an in-line comment
-                char * comment_pos = strchr(line, '#'); // finding index of comment
-                if (comment_pos != NULL){
-                    *comment_pos = '\0';
-                }
-                char * trimmed_line = trim(line);
-
-                // checking for empty lines or comment lines
-                if (strlen(trimmed_line) == 0){
-                        continue;
-                }
-                if (trimmed_line[0] == '#'){
-                        continue;
-                }
-
-                // echo back the request
-                fprintf(stdout, "+ %s\n", trimmed_line);
-
-                // creating token to read requests
-                char * token;
-                int line_length = strlen(trimmed_line);
-                token = strtok(trimmed_line, " ");
-
-                // checking for requests
-                if (strcmp(token, "quit") == 0){
-                        fclose(fp);
-                        quit();
-                }
-                else if (strcmp(token, "addPart") == 0){
-                        char * ID = strtok(NULL, " ");
-
-                        add_part(&inv, ID);
-                }
-                else if (strcmp(token, "addAssembly") == 0){
-                        // assists in checking invalid input
-                        int errorChecker = 1;
-
-                        char * ID = strtok(NULL, " ");
-                        if (ID == NULL){
-                                fprintf(stderr, "!!! Invalid input\n");
-                                continue;
-                        }
-
-                        char * capacityString = strtok(NULL, " ");
-                        if (capacityString == NULL){
-                                fprintf(stderr, "!!! Invalid input\n");
-                                continue;
-                        }
-                        int capacity = atoi(capacityString);
-
-                        // creating items list
-                        items_needed_t * items = malloc(sizeof(items_needed_t));
-                        if (items == NULL){
-                                fprintf(stderr, "!!! Memory allocation failed\n");
-                                free(items);
-                        }
-
-                        items->item_list = NULL;
-                        items->item_count = 0;
-
-                        // keeping track of the last item added
-                        token = strtok(NULL, " ");
-                        while (token != NULL){
-                                char itemName[ID_MAX + 1];
-                                int quantity;
-
-                                strcpy(itemName, token);
-                                token = strtok(NULL, " ");
-
-                                // checking for mismatched ITEM-ID pairing
-                                if (token == NULL){
-                                        errorChecker = -1;
-                                        fprintf(stderr, "!!! Invalid input\n");
-                                        item_t * current_item = items->item_list;
-                                        while (current_item != NULL){
-                                                item_t * temp = current_item;
-                                                current_item = current_item->next;
-                                                free(temp);
-                                        }
-                                        free(items);
-                                        break;
-                                }
-
-                                quantity = atoi(token);
-
-                                // remaining checks
-                                if (lookup_part(inv.part_list, itemName) == NULL && lookup_assembly(inv.assembly_list, itemName) == NULL){
-                                        fprintf(stderr, "!!! %s: part/assembly ID is not in the inventory\n", itemName);
-                                        errorChecker = -1;
-                                        item_t * current_item = items->item_list;
-                                        while (current_item != NULL){
-                                                item_t * temp = current_item;
-                                                current_item = current_item->next;
-                                                free(temp);
-                                        }
-                                        free(items);
-                                        break;
-                                }
-
-                                if (quantity <= 0){
-                                        fprintf(stderr, "!!! %d: illegal quantity for ID %s\n", quantity, itemName);
-                                        errorChecker = -1;
-                                        item_t * current_item = items->item_list;
-                                        while (current_item != NULL){
-                                                item_t * temp = current_item;
-                                                current_item = current_item->next;
-                                                free(temp);
-                                        }
-                                        free(items);
-                                        break;
-                                }
-
-                                token = strtok(NULL, " ");
-
-                                add_item(items, itemName, quantity);
-                        }
-
-                        if (errorChecker == -1){
-                                continue;
-                        }
-
-                        add_assembly(&inv, ID, capacity, items);
-                }
-                else if (strcmp(token, "fulfillOrder") == 0){
-                        char * order = malloc(line_length * sizeof(char) + 1);
-                        memset(order, 0, line_length * sizeof(char) + 1);
-                        // getting the rest of the line into one string
-                        token = strtok(NULL, " ");
-                        while (token != NULL){
-                                strcat(order, token);
-                                strcat(order, " ");
-                                // printf("%s\n", token);
-                                token = strtok(NULL, " ");
-                        }
-                        // capping off the string
-                        strcat(order, "\0");
-
-                        fulfillOrder(order);
-                        free(order);
-                }
-                else if (strcmp(token, "stock") == 0){
-                        char * ID = strtok(NULL, " ");
-                        char * quantityString = strtok(NULL, " ");
-                        int quantity = atoi(quantityString);
-                        stock(&inv, ID, quantity);
-                }
-                else if (strcmp(token, "restock") == 0){
-                        char * ID = strtok(NULL, " ");
-                        restock(&inv, ID);
-                }
-                else if (strcmp(token, "empty") == 0){
-                        char * ID = strtok(NULL, " ");
-                        empty(ID);
-                }
-                else if (strcmp(token, "inventory") == 0){
-                        char * ID = strtok(NULL, " ");
-                        inventory(ID);
-                }
-                else if (strcmp(token, "parts") == 0){
-                        parts();
-                }
-                else if (strcmp(token, "help") == 0){
-                        help();
-                }
-                else if (strcmp(token, "clear") == 0){
-                        clear();
-                }
-                else {
-                    fprintf(stderr, "!!! %s: unknown command\n", token);
-                }
-        }
-        clear();
-        fclose(fp);
-        return EXIT_SUCCESS;
-}
+/*
+ * @author: Ryan Chen, rwc6613@rit.edu
+ */
+
+// inventory.c file
+#define _POSIX_C_SOURCE 200112L // pthreads, sysconf()
+#include "inventory.h"
+#include <stdarg.h>
+#include <limits.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#ifdef __GLIBC__
+#include <malloc.h> // malloc_usable_size()
+#endif
+#ifdef INPUT_GZIP
+#include <zlib.h>
+#endif
+#ifdef INPUT_ZSTD
+#include <zstd.h>
+#endif
+
+#define MAX_LINE_LENGTH 256
+#define IMPORT_CHUNK_MIN (1 << 20) // bytes of import file per parsing thread
+#define DENSE_MIN_PARTS 4          // recipes with fewer parts than this always use the sparse form
+#define DENSE_MAX_SPREAD 4         // a dense copy may be at most this many times longer than the part count
+#define PARALLEL_MIN_NODES 65536   // make() calls an explosion needs before it is spread across threads
+#define EXPLODE_GRAIN 4096         // make() calls a sub-assembly needs before it becomes its own task
+#define RESTOCK_GRAIN 4096         // make() calls a restock of every assembly needs for each thread it is spread across
+
+// the AVX2 demand kernel is picked at runtime on x86-64 builds with GCC or Clang
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define DEMAND_SIMD 1
+#include <immintrin.h>
+#else
+#define DEMAND_SIMD 0
+#endif
+
+// static tracepoints for perf and bpftrace, provider "inventory": request, order__start, order__done, stock__start,
+// stock__done, restock__start, restock__done, make, get, lookup__part and lookup__assembly. With <sys/sdt.h> each one
+// is a single nop until a tracer attaches to it; without the header, or with -DNO_PROBES, they compile to nothing
+#if defined(__has_include) && !defined(NO_PROBES)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define PROBES 1
+#endif
+#endif
+#ifndef PROBES
+#define PROBES 0
+#endif
+#if PROBES
+#define PROBE1(name, a) DTRACE_PROBE1(inventory, name, a)
+#define PROBE2(name, a, b) DTRACE_PROBE2(inventory, name, a, b)
+#define PROBE3(name, a, b, c) DTRACE_PROBE3(inventory, name, a, b, c)
+#else
+#define PROBE1(name, a) do { (void)(a); } while (0)
+#define PROBE2(name, a, b) do { (void)(a); (void)(b); } while (0)
+#define PROBE3(name, a, b, c) do { (void)(a); (void)(b); (void)(c); } while (0)
+#endif
+
+inventory_t inv = {.part_list = NULL, .part_count = 0, .assembly_list = NULL, .assembly_count = 0};
+
+// allocation accounting, one entry per mem_kind
+struct mem_stats mem_usage[MEM_KINDS];
+size_t mem_peak = 0;  // highest total (live + overhead) seen so far
+size_t mem_allocations = 0; // every allocation so far, for telling whether requests allocate
+size_t mem_limit = 0; // memory ceiling in bytes, 0 means no limit
+pthread_mutex_t mem_lock = PTHREAD_MUTEX_INITIALIZER; // allocations may come from worker threads
+
+// every change to an assembly's on_hand, see set_on_hand()
+struct change_feed feed = {.log = NULL, .first_seq = 1, .last_seq = 0, .subscriber_count = 0};
+
+unsigned visit_mark = 0; // stamped on assemblies by searches of the assembly graph
+
+// how results are written to standard output, and the record they are built in (main thread only)
+enum output_format output_format = FORMAT_TEXT;
+struct record output_record = {.data = NULL, .length = 0, .capacity = 0, .failed = 0};
+enum make_report make_report = MAKE_REPORT_EACH;
+
+// reservations, by ID and on the timing wheel
+struct reservations reservations = {.now = 0, .started = 0, .buckets = NULL, .bucket_count = 0, .count = 0, .next_id = 1};
+
+// the main thread's planning workspace, see workspace_demand()
+struct workspace workspace = {.parts_busy = 0, .part_capacity = 0, .assembly_capacity = 0, .sort = NULL, .sort_capacity = 0,
+                              .order = {.item_list = NULL, .item_count = 0, .spare = NULL}};
+
+// every fulfillOrder runs as a transaction in this log, see undo_begin()
+struct undo_log order_undo = {.entries = NULL, .count = 0, .capacity = 0, .held = {.data = NULL, .length = 0, .capacity = 0, .failed = 0},
+                              .line = {.data = NULL, .length = 0, .capacity = 0, .failed = 0}, .failed = 0};
+long long order_budget = 0; // most parts one order may need, 0 for no budget
+
+// the workers, or the coordinator this worker answers to, see partition_start()
+struct partitions partitions = {.count = 0, .self = -1, .in = NULL, .out = NULL, .replying = 0, .open = 0, .pending = 0};
+struct replication replication = {.role = REPLICATION_NONE, .path = NULL, .lock = PTHREAD_MUTEX_INITIALIZER, .changed = PTHREAD_COND_INITIALIZER,
+                                  .held = 0, .journal = NULL, .first_seq = 1, .last_seq = 0, .signaled_seq = 0, .listen_fd = -1,
+                                  .applied_seq = -1, .ready = 0};
+
+// the lanes a restock of every assembly is spread across, see restock_parallel()
+struct parallel_restock parallel_restock = {.invp = NULL, .assemblies = NULL, .count = 0, .steps = NULL, .step_capacity = 0};
+
+// a catalog being built by reloadCatalog, and assemblies it dropped that the change feed still points at; see catalog_poll()
+struct catalog_reload catalog_reload = {.filename = NULL, .text = NULL, .text_size = 0, .started = 0, .building = 0, .built = 0, .interactive = 0,
+                                        .next = {.part_list = NULL, .part_count = 0, .assembly_list = NULL, .assembly_count = 0},
+                                        .errors = NULL, .retired = NULL};
+
+// --capture and --replay, see "THESE ARE USED FOR CAPTURE AND REPLAY"
+struct capture capture = {.fp = NULL};
+struct replay replay = {.active = 0, .paced = 0, .first_stamp = -1, .in_flight = 0, .latencies = NULL, .count = 0, .capacity = 0};
+
+// tracing of make()/get(), see trace_start()
+int tracing = 0;
+struct tracer tracer = {.fp = NULL, .filename = NULL, .key_ready = 0, .lock = PTHREAD_MUTEX_INITIALIZER, .buffers = NULL, .thread_count = 0, .lost = 0};
+
+void add_part(inventory_t * invp, char * id){
+        // checking for invalid ID
+        if (id[0] != 'P'){
+                report_error("%s: part ID must start with 'P'", id);
+                return;
+        }
+        if (strlen(id) > ID_MAX){
+                report_error("%s: part ID too long", id);
+                return;
+        }
+
+        // checking for duplicate ID
+        part_t * part_lookup_pointer = find_part(invp, id);
+        if (part_lookup_pointer != NULL){
+                report_error("%s: duplicate part ID", id);
+                return;
+        }
+
+        // checking against the memory ceiling
+        if (mem_over_limit(sizeof(struct part))){
+                report_error("%s: memory limit exceeded", id);
+                return;
+        }
+
+        if (part_create(invp, id) == NULL){
+                report_error("Memory allocation failed");
+        }
+}
+
+part_t * part_create(inventory_t * invp, char * id){
+        // creating new part
+        struct part * new_part = (struct part *)mem_alloc(MEM_PART, sizeof(struct part));
+        // checking for allocation
+        if (new_part == NULL){
+                return NULL;
+        }
+        strcpy(new_part->id, id);
+        new_part->id[ID_MAX] = '\0';
+        new_part->next = NULL;
+
+        if (link_part(invp, new_part) != 0){
+                mem_free(MEM_PART, new_part, sizeof(struct part));
+                return NULL;
+        }
+        return new_part;
+}
+
+void add_assembly(inventory_t * invp, char * id, long long capacity, items_needed_t * items){
+        // checking for invalid ID
+        if (id[0] != 'A'){
+                report_error("%s: assembly ID must start with 'A'", id);
+                free_items(items);
+                return;
+        }
+        if (strlen(id) > ID_MAX){
+                report_error("%s: assembly ID too long", id);
+                free_items(items);
+                return;
+        }
+        if (capacity < 0){
+                report_error("%lld: illegal capacity for ID %s", capacity, id);
+                free_items(items);
+                return;
+        }
+
+        // checking for duplicate ID
+        assembly_t * assembly_lookup_pointer = find_assembly(invp, id);
+        if (assembly_lookup_pointer != NULL){
+                report_error("%s: duplicate assembly ID", id);
+                free_items(items);
+                return;
+        }
+
+        // checking against the memory ceiling; the recipe has already been allocated, so it counts too
+        if (mem_over_limit(sizeof(struct assembly))){
+                report_error("%s: memory limit exceeded", id);
+                free_items(items);
+                return;
+        }
+
+        if (assembly_create(invp, id, capacity, items) == NULL){
+                report_error("Memory allocation failed");
+                free_items(items);
+        }
+}
+
+assembly_t * assembly_create(inventory_t * invp, char * id, long long capacity, items_needed_t * items){
+        // creating new assembly
+        struct assembly * new_assembly = (struct assembly *)mem_alloc(MEM_ASSEMBLY, sizeof(struct assembly));
+
+        // checking for allocation
+        if (new_assembly == NULL){
+                return NULL;
+        }
+        strcpy(new_assembly->id, id);
+        new_assembly->id[ID_MAX] = '\0';
+        new_assembly->capacity = capacity;
+        new_assembly->on_hand = 0;
+        new_assembly->items = items;
+        new_assembly->changed_seq = 0;
+        new_assembly->reserved = 0;
+        new_assembly->unit = NULL;
+        new_assembly->visit_mark = 0;
+        new_assembly->next = NULL;
+
+        if (link_assembly(invp, new_assembly) != 0){
+                mem_free(MEM_ASSEMBLY, new_assembly, sizeof(struct assembly));
+                return NULL;
+        }
+        count_tree_nodes(invp, new_assembly);
+        place_assembly(invp, new_assembly);
+        join_components(invp, new_assembly);
+        return new_assembly;
+}
+
+int add_item(items_needed_t * items, char * id, long long quantity){
+        // looking for matching item IDs
+        item_t * item_lookup_pointer = lookup_item(items->item_list, id);
+
+        // if the item was found, aka != NULL, add quantity, otherwise make the new item
+        if (item_lookup_pointer != NULL){
+                if (quantity > LLONG_MAX - item_lookup_pointer->quantity){
+                        return -1;
+                }
+                item_lookup_pointer->quantity += quantity;
+        }
+        else{
+                // making the new item, or reusing one items_clear() kept
+                struct item * new_item = items->spare;
+                if (new_item != NULL){
+                        items->spare = new_item->next;
+                }
+                else{
+                        new_item = (struct item *)mem_alloc(MEM_ITEM, sizeof(struct item));
+                }
+                if (new_item == NULL){
+                        report_error("Memory allocation failed");
+                        return -1;
+                }
+                strcpy(new_item->id, id);
+                new_item->quantity = quantity;
+                new_item->next = NULL;
+
+                // if-else statement is redundant, can reduce it
+                // adding it to the list
+                if (items->item_list == NULL){
+                        items->item_list = new_item;
+                }
+                else{
+                        struct item * current_item = items->item_list;
+                        while (current_item->next != NULL){
+                                current_item = current_item->next;
+                        }
+                        current_item->next = new_item;
+                }
+                items->item_count += 1;
+        }
+        return 0;
+}
+
+void free_items(items_needed_t * items){
+        if (items == NULL){
+                return;
+        }
+        items_clear(items);
+        item_t * current_item = items->spare;
+        while (current_item != NULL){
+                item_t * temp = current_item;
+                current_item = current_item->next;
+                mem_free(MEM_ITEM, temp, sizeof(item_t));
+        }
+        mem_free(MEM_ITEMS_NEEDED, items, sizeof(items_needed_t));
+}
+
+void items_clear(items_needed_t * items){
+        if (items->item_list == NULL){
+                return;
+        }
+        item_t * last = items->item_list;
+        while (last->next != NULL){
+                last = last->next;
+        }
+        last->next = items->spare;
+        items->spare = items->item_list;
+        items->item_list = NULL;
+        items->item_count = 0;
+}
+
+void fulfillOrder(char * order){
+        // the order's items, in the workspace's list; it is cleared again by the next order
+        items_needed_t * items = workspace_order(&workspace);
+
+        // main loop for parsing and adding items to item list
+        char * token;
+        token = strtok(order, " ");
+        while (token != NULL){
+                char * ID = token;
+                char * string_quantity = strtok(NULL, " ");
+
+                // checking for valid inputs before continuing
+                if (ID == NULL || string_quantity == NULL){
+                        report_error("Invalid input");
+                        return;
+                }
+                long long quantity = atoll(string_quantity);
+
+                // checking for valid inputs starting with 'A' and valid quantity number, as well as whether the assembly requested exists
+                if (ID[0] != 'A'){
+                        report_error("%s: assembly ID is not in the inventory -- order canceled", ID);
+                        return;
+                }
+
+                assembly_t * assembly_lookup_pointer = find_assembly(&inv, ID);
+                if (assembly_lookup_pointer == NULL){
+                        report_error("%s: assembly ID is not in the inventory -- order canceled", ID);
+                        return;
+                }
+
+                if (quantity <= 0){
+                        report_error("%lld: illegal order quantity for ID %s -- order canceled", quantity, ID);
+                        return;
+                }
+
+                if (add_item(items, ID, quantity) != 0){
+                        report_error("%s: quantity overflow -- order canceled", ID);
+                        return;
+                }
+
+                token = strtok(NULL, " ");
+        }
+
+        demand_t * parts = workspace_demand(&workspace, &inv);
+        if (parts == NULL){
+                report_error("Memory allocation failed");
+                return;
+        }
+
+        // getting and maintaining list for parts requested, all or nothing
+        PROBE2(order__start, items->item_count, order_budget);
+        undo_begin(&order_undo);
+        parts->undo = &order_undo;
+        if (!partition_scatter(items, parts)){
+                struct item * current_item = items->item_list;
+                while (current_item != NULL){
+                        if (get(&inv, find_assembly(&inv, current_item->id), current_item->quantity, parts) != 0){
+                                break;
+                        }
+                        current_item = current_item->next;
+                }
+        }
+
+        // committing and printing 'parts', or putting every on_hand back
+        long long total = parts->overflow ? 0 : demand_total(parts);
+        int committed = 0;
+        if (parts->overflow){
+                undo_rollback(&order_undo);
+                report_error("quantity overflow -- order canceled");
+        }
+        else if (order_undo.failed || order_undo.held.failed){
+                undo_rollback(&order_undo);
+                report_error("Memory allocation failed -- order canceled");
+        }
+        else if (order_budget > 0 && total > order_budget){
+                undo_rollback(&order_undo);
+                report_error("%lld: parts needed exceed the budget of %lld -- order canceled", total, order_budget);
+        }
+        else{
+                undo_commit(&order_undo);
+                print_made(parts);
+                print_parts_needed(&inv, parts);
+                committed = 1;
+        }
+        PROBE2(order__done, committed, total);
+        // handing 'parts' back to the workspace
+        workspace_release(&workspace, parts);
+}
+
+void stock(inventory_t * invp, char *id, long long n){
+        // checks
+        if (n <= 0){
+                report_error("%lld: illegal quantity for ID %s", n, id);
+        }
+
+        assembly_t * current_assembly = find_assembly(&inv, id);
+
+        // checking for valid id
+        if (current_assembly == NULL){
+                report_error("%s: assembly ID is not in the inventory", id);
+                return;
+        }
+
+        // a parts needed list
+        demand_t * parts = workspace_demand(&workspace, invp);
+        if (parts == NULL){
+                report_error("Memory allocation failed");
+                return;
+        }
+
+        long long capacity = current_assembly->capacity;
+        long long on_hand = current_assembly->on_hand;
+
+        // checking for exceeding maximum capacity; if requested amount results in over capacity, only make enough to capacity
+        long long amt_needed = n;
+        if (n > capacity - on_hand){
+                amt_needed = capacity - on_hand;
+        }
+
+        PROBE2(stock__start, current_assembly->id, amt_needed);
+        int made = make(invp, current_assembly, amt_needed, parts) == 0;
+        if (made){
+                set_on_hand(current_assembly, current_assembly->on_hand + amt_needed);
+        }
+        PROBE3(stock__done, current_assembly->id, amt_needed, made);
+
+        // printing out what was made and the parts needed
+        print_made(parts);
+        if (parts->overflow){
+                report_error("quantity overflow -- parts list unavailable");
+        }
+        else{
+                print_parts_needed(invp, parts);
+        }
+
+        // handing the parts needed list back to the workspace
+        workspace_release(&workspace, parts);
+}
+
+void restock(inventory_t * invp, char *id){
+        // a parts needed list
+        demand_t * parts = workspace_demand(&workspace, invp);
+        if (parts == NULL){
+                report_error("Memory allocation failed");
+                return;
+        }
+        PROBE1(restock__start, id != NULL ? id : "");
+
+        if (id == NULL){
+                // turning my list into an array to work from LIFO (last in, first out)
+                assembly_t ** assembly_array = (assembly_t **)workspace_sort(&workspace, inv.assembly_count);
+                if (assembly_array == NULL){
+                        report_error("Memory allocation failed");
+                        workspace_release(&workspace, parts);
+                        return;
+                }
+                int count = 0;
+                for (assembly_t * current = inv.assembly_list; current != NULL; current = current->next){
+                        assembly_array[count++] = current;
+                }
+
+                // families of assemblies that share nothing can be restocked on threads of their own
+                int first = inv.assembly_count - 1;
+                if (restock_parallel(invp, assembly_array, count, parts)){
+                        first = -1;
+                }
+
+                // iterating through each item LIFO
+                for (int i = first; i >= 0; i--){
+                        assembly_t * current_assembly;
+                        // checking to ensure pointer isn't NULL
+                        if (assembly_array[i] != NULL){
+                                current_assembly = assembly_array[i];
+                        }
+                        else{
+                                continue;
+                        }
+                        char * current_id = current_assembly->id;
+                        long long capacity = current_assembly->capacity;
+                        long long on_hand = current_assembly->on_hand;
+
+                        // if there aren't enough of a certain assembly, make it and all it's parts
+                        if (is_low(on_hand, capacity)){
+                                long long amt_needed = capacity - on_hand;
+                                emit_restock(current_id, amt_needed);
+                                if (make(invp, current_assembly, amt_needed, parts) != 0){
+                                        break;
+                                }
+                                set_on_hand(current_assembly, current_assembly->on_hand + amt_needed);
+                        }
+                }
+        }
+        else{
+                assembly_t * current_assembly = find_assembly(&inv, id);
+                if (current_assembly == NULL){
+                        report_error("%s: assembly ID is not in the inventory", id);
+                        PROBE2(restock__done, id, 0);
+                        workspace_release(&workspace, parts);
+                        return;
+                }
+                char * current_id = current_assembly->id;
+                long long capacity = current_assembly->capacity;
+                long long on_hand = current_assembly->on_hand;
+
+                if (is_low(on_hand, capacity)){
+                        long long amt_needed = capacity - on_hand;
+                        if (make(invp, current_assembly, amt_needed, parts) == 0){
+                                set_on_hand(current_assembly, current_assembly->on_hand + amt_needed);
+                                emit_restock(current_id, amt_needed);
+                        }
+                }
+        }
+
+        // printing out what was made and the parts needed
+        print_made(parts);
+        if (parts->overflow){
+                report_error("quantity overflow -- parts list unavailable");
+        }
+        else{
+                print_parts_needed(invp, parts);
+        }
+        PROBE2(restock__done, id != NULL ? id : "", parts->overflow);
+        // handing the parts needed list back to the workspace
+        workspace_release(&workspace, parts);
+}
+
+void empty(char *id){
+        if (id[0] != 'A'){
+                report_error("%s: ID not an assembly", id);
+                return;
+        }
+        assembly_t * assembly_lookup_pointer = find_assembly(&inv, id);
+        if (assembly_lookup_pointer == NULL){
+                report_error("%s: assembly ID is not in the inventory", id);
+                return;
+        }
+
+        set_on_hand(assembly_lookup_pointer, 0);
+}
+
+void inventory(char *id){
+        if (id == NULL){
+                emit_text("Assembly inventory:\n");
+                emit_text("-------------------\n");
+
+                if (inv.assembly_list == NULL){
+                        emit_text("EMPTY INVENTORY\n");
+                }
+                else{
+                        emit_inventory_header();
+
+                        assembly_t ** assembly_array = (assembly_t **)workspace_sort(&workspace, inv.assembly_count);
+                        if (assembly_array == NULL){
+                                report_error("Memory allocation failed");
+                                return;
+                        }
+                        int count = 0;
+                        for (assembly_t * current = inv.assembly_list; current != NULL; current = current->next){
+                                assembly_array[count++] = current;
+                        }
+                        qsort(assembly_array, inv.assembly_count, sizeof(assembly_t *), assembly_compare);
+
+                        for (int i = 0; i < inv.assembly_count; i++){
+                                emit_inventory_row(assembly_array[i], assembly_array[i]->on_hand);
+                        }
+                }
+        }
+         else{
+                // checking for assembly id existing
+                assembly_t * assembly = find_assembly(&inv, id);
+
+                if (assembly == NULL){
+                        report_error("%s: part/assembly ID is not in the inventory", id);
+                        return;
+                }
+
+                item_t * items = assembly->items->item_list;
+                int item_count = assembly->items->item_count;
+
+                if (items != NULL){
+                        item_t ** item_array = (item_t **)workspace_sort(&workspace, item_count);
+                        if (item_array == NULL){
+                                report_error("Memory allocation failed");
+                                return;
+                        }
+                        for (int i = 0; i < item_count; i++){
+                                item_array[i] = items;
+                                items = items->next;
+                        }
+
+                        qsort(item_array, item_count, sizeof(item_t*), item_compare);
+                        emit_assembly(assembly, item_array, item_count);
+                }
+                else{
+                        emit_assembly(assembly, NULL, 0);
+                }
+        }
+}
+
+void inventory_since(long since){
+        if (since < 0 || since > feed.last_seq){
+                report_error("%ld: illegal change number", since);
+                return;
+        }
+
+        // if the log has wrapped past "since", the caller has to start over from the whole inventory
+        if (since + 1 < feed.first_seq){
+                report_error("%ld: change number is no longer in the change feed -- showing whole inventory", since);
+                inventory(NULL);
+                emit_change_sequence(feed.last_seq);
+                return;
+        }
+
+        // collecting each changed assembly once, at its latest change; counted first, so the room needed is
+        // bounded by the assemblies rather than by how many changes there have been
+        int count = 0;
+        for (long seq = since + 1; seq <= feed.last_seq; seq++){
+                count += feed.log[seq & (CHANGE_LOG_SIZE - 1)].assembly->changed_seq == seq;
+        }
+        assembly_t ** assembly_array = NULL;
+        if (count > 0){
+                assembly_array = (assembly_t **)workspace_sort(&workspace, count);
+                if (assembly_array == NULL){
+                        report_error("Memory allocation failed");
+                        return;
+                }
+                count = 0;
+                for (long seq = since + 1; seq <= feed.last_seq; seq++){
+                        struct change * change = &feed.log[seq & (CHANGE_LOG_SIZE - 1)];
+                        if (change->assembly->changed_seq == seq){
+                                assembly_array[count++] = change->assembly;
+                        }
+                }
+                qsort(assembly_array, count, sizeof(assembly_t *), assembly_compare);
+        }
+
+        emit_text("Assembly changes:\n");
+        emit_text("-----------------\n");
+        if (count == 0){
+                emit_text("NO CHANGES\n");
+        }
+        else{
+                emit_inventory_header();
+                for (int i = 0; i < count; i++){
+                        emit_inventory_row(assembly_array[i], assembly_array[i]->on_hand);
+                }
+        }
+        emit_change_sequence(feed.last_seq);
+}
+
+void subscribe(char * filename, int low_only){
+        for (int i = 0; i < feed.subscriber_count; i++){
+                if (strcmp(feed.subscribers[i].filename, filename) == 0){
+                        report_error("%s: already subscribed", filename);
+                        return;
+                }
+        }
+        if (feed.subscriber_count == MAX_SUBSCRIBERS){
+                report_error("%s: too many subscribers", filename);
+                return;
+        }
+
+        FILE * fp = fopen(filename, "a");
+        if (fp == NULL){
+                report_error("%s: cannot open file", filename);
+                return;
+        }
+        char * name = mem_alloc(MEM_FEED, strlen(filename) + 1);
+        if (name == NULL){
+                report_error("Memory allocation failed");
+                fclose(fp);
+                return;
+        }
+        strcpy(name, filename);
+
+        struct subscriber * subscriber = &feed.subscribers[feed.subscriber_count++];
+        subscriber->filename = name;
+        subscriber->fp = fp;
+        subscriber->low_only = low_only;
+        fprintf(fp, "%ld subscribed\n", feed.last_seq);
+}
+
+void unsubscribe(char * filename){
+        for (int i = 0; i < feed.subscriber_count; i++){
+                struct subscriber * subscriber = &feed.subscribers[i];
+                if (strcmp(subscriber->filename, filename) == 0){
+                        fclose(subscriber->fp);
+                        mem_free(MEM_FEED, subscriber->filename, strlen(subscriber->filename) + 1);
+                        feed.subscribers[i] = feed.subscribers[--feed.subscriber_count];
+                        return;
+                }
+        }
+        report_error("%s: not subscribed", filename);
+}
+
+void parts(){
+        // simply printing out what parts we have
+        emit_text("Part inventory:\n");
+        emit_text("---------------\n");
+        if (inv.part_count == 0){
+                emit_text("NO PARTS\n");
+        }
+        else {
+                part_t ** part_array = (part_t **)workspace_sort(&workspace, inv.part_count);
+                if (part_array == NULL){
+                        report_error("Memory allocation failed");
+                        return;
+                }
+                // the part table is already in list order
+                memcpy(part_array, inv.part_table, inv.part_count * sizeof(part_t *));
+                qsort(part_array, inv.part_count, sizeof(part_t *), part_compare);
+                emit_text("Part ID\n");
+                emit_text("===========\n");
+                for (int i = 0; i < inv.part_count; i++){
+                        emit_part(part_array[i]->id);
+                }
+        }
+}
+
+void import_parts(inventory_t * invp, char * filename){
+        struct import_chunk * chunks;
+        int chunk_count;
+        if (import_load(filename, 0, &chunks, &chunk_count) != 0){
+                return;
+        }
+
+        // duplicate detection by sorting, instead of one lookup per line against a growing list
+        int count = 0;
+        struct import_record ** sorted = import_sorted(chunks, chunk_count, &count);
+        if (sorted == NULL){
+                report_error("Memory allocation failed");
+                import_free(chunks, chunk_count);
+                return;
+        }
+        for (int i = 0; i < count; i++){
+                if ((i > 0 && strcmp(sorted[i]->id, sorted[i - 1]->id) == 0) || find_part(invp, sorted[i]->id) != NULL){
+                        import_add_error(&chunks[0], sorted[i]->line, "%s: duplicate part ID", sorted[i]->id);
+                }
+        }
+        mem_free(MEM_SCRATCH, sorted, (count + 1) * sizeof(struct import_record *));
+
+        if (import_report_errors(filename, chunks, chunk_count, "import") > 0){
+                import_free(chunks, chunk_count);
+                return;
+        }
+        if (mem_over_limit(count * (sizeof(struct part) + mem_overhead(NULL, sizeof(struct part))))){
+                report_error("%s: memory limit exceeded -- import canceled", filename);
+                import_free(chunks, chunk_count);
+                return;
+        }
+
+        // sizing the index and part table once for everything, then appending in file order
+        if (index_reserve(&invp->part_index, invp->part_index.count + count) != 0 || part_table_reserve(invp, invp->part_count + count) != 0){
+                report_error("Memory allocation failed");
+                import_free(chunks, chunk_count);
+                return;
+        }
+        int added = 0;
+        int failed = 0;
+        for (int i = 0; i < chunk_count && !failed; i++){
+                for (int j = 0; j < chunks[i].record_count; j++){
+                        part_t * new_part = mem_alloc(MEM_PART, sizeof(part_t));
+                        if (new_part == NULL){
+                                failed = 1;
+                                break;
+                        }
+                        strcpy(new_part->id, chunks[i].records[j].id);
+                        new_part->next = NULL;
+                        if (link_part(invp, new_part) != 0){
+                                mem_free(MEM_PART, new_part, sizeof(part_t));
+                                failed = 1;
+                                break;
+                        }
+                        added++;
+                }
+        }
+        import_free(chunks, chunk_count);
+        if (failed){
+                import_report_stopped(filename, "parts", added, count);
+                return;
+        }
+        emit_imported(filename, "parts", added);
+}
+
+void import_assemblies(inventory_t * invp, char * filename){
+        struct import_chunk * chunks;
+        int chunk_count;
+        if (import_load(filename, 1, &chunks, &chunk_count) != 0){
+                return;
+        }
+
+        int count = 0;
+        struct import_record ** sorted = import_sorted(chunks, chunk_count, &count);
+        if (sorted == NULL){
+                report_error("Memory allocation failed");
+                import_free(chunks, chunk_count);
+                return;
+        }
+
+        // duplicates sit next to each other once sorted
+        for (int i = 0; i < count; i++){
+                if ((i > 0 && strcmp(sorted[i]->id, sorted[i - 1]->id) == 0) || find_assembly(invp, sorted[i]->id) != NULL){
+                        import_add_error(&chunks[0], sorted[i]->line, "%s: duplicate assembly ID", sorted[i]->id);
+                }
+        }
+
+        // one pass over every recipe: each component must be a known part, a known assembly,
+        // or an assembly defined on an earlier line of this file (which also rules out cycles)
+        size_t components = 0;
+        for (int i = 0; i < chunk_count; i++){
+                for (int j = 0; j < chunks[i].record_count; j++){
+                        struct import_record * record = &chunks[i].records[j];
+                        for (int k = 0; k < record->component_count; k++){
+                                char * item_id = chunks[i].components[record->first_component + k].id;
+                                int known = 0;
+                                if (item_id[0] == 'P'){
+                                        known = find_part(invp, item_id) != NULL;
+                                }
+                                else if (item_id[0] == 'A'){
+                                        known = find_assembly(invp, item_id) != NULL;
+                                        if (!known){
+                                                struct import_record key;
+                                                struct import_record * key_pointer = &key;
+                                                strcpy(key.id, item_id);
+                                                key.line = 0; // sorts before any real line with this ID
+                                                int low = 0;
+                                                int high = count;
+                                                while (low < high){
+                                                        int middle = low + (high - low) / 2;
+                                                        if (import_record_compare(&sorted[middle], &key_pointer) < 0){
+                                                                low = middle + 1;
+                                                        }
+                                                        else{
+                                                                high = middle;
+                                                        }
+                                                }
+                                                known = low < count && strcmp(sorted[low]->id, item_id) == 0 && sorted[low]->line < record->line;
+                                        }
+                                }
+                                if (!known){
+                                        import_add_error(&chunks[0], record->line, "%s: part/assembly ID is not in the inventory", item_id);
+                                }
+
+                                // a repeated component adds up, and the total has to fit; counted at its first appearance
+                                long long total = chunks[i].components[record->first_component + k].quantity;
+                                for (int m = 0; m < record->component_count && total >= 0; m++){
+                                        struct import_component * other = &chunks[i].components[record->first_component + m];
+                                        if (m == k || strcmp(other->id, item_id) != 0){
+                                                continue;
+                                        }
+                                        if (m < k){
+                                                break;
+                                        }
+                                        if (other->quantity > LLONG_MAX - total){
+                                                import_add_error(&chunks[0], record->line, "%lld: illegal quantity for ID %s", other->quantity, item_id);
+                                                total = -1;
+                                        }
+                                        else{
+                                                total += other->quantity;
+                                        }
+                                }
+                        }
+                        components += record->component_count;
+                }
+        }
+        mem_free(MEM_SCRATCH, sorted, (count + 1) * sizeof(struct import_record *));
+
+        if (import_report_errors(filename, chunks, chunk_count, "import") > 0){
+                import_free(chunks, chunk_count);
+                return;
+        }
+        size_t bytes = count * (sizeof(assembly_t) + mem_overhead(NULL, sizeof(assembly_t)) + sizeof(items_needed_t) + mem_overhead(NULL, sizeof(items_needed_t)))
+                     + components * (sizeof(item_t) + mem_overhead(NULL, sizeof(item_t)));
+        if (mem_over_limit(bytes)){
+                report_error("%s: memory limit exceeded -- import canceled", filename);
+                import_free(chunks, chunk_count);
+                return;
+        }
+
+        // sizing the index once for everything, then appending in file order
+        if (index_reserve(&invp->assembly_index, invp->assembly_index.count + count) != 0){
+                report_error("Memory allocation failed");
+                import_free(chunks, chunk_count);
+                return;
+        }
+        int added = 0;
+        int failed = 0;
+        for (int i = 0; i < chunk_count && !failed; i++){
+                for (int j = 0; j < chunks[i].record_count; j++){
+                        struct import_record * record = &chunks[i].records[j];
+                        items_needed_t * items = mem_calloc(MEM_ITEMS_NEEDED, 1, sizeof(items_needed_t));
+                        if (items == NULL){
+                                failed = 1;
+                                break;
+                        }
+                        // no total can overflow by now, so only an allocation can fail
+                        for (int k = 0; k < record->component_count && !failed; k++){
+                                struct import_component * component = &chunks[i].components[record->first_component + k];
+                                failed = add_item(items, component->id, component->quantity) != 0;
+                        }
+                        if (failed || assembly_create(invp, record->id, record->capacity, items) == NULL){
+                                free_items(items);
+                                failed = 1;
+                                break;
+                        }
+                        added++;
+                }
+        }
+        import_free(chunks, chunk_count);
+        if (failed){
+                import_report_stopped(filename, "assemblies", added, count);
+                return;
+        }
+        emit_imported(filename, "assemblies", added);
+}
+
+void memory(){
+        const char * names[MEM_KINDS] = {"part_t", "assembly_t", "items_needed_t", "item_t", "id_index", "change_feed", "unit_demand", "scratch", "trace", "reservation", "journal", "input", "workspace"};
+        size_t total_count = 0;
+        size_t total_bytes = 0;
+        size_t total_overhead = 0;
+
+        emit_text("Memory usage:\n");
+        emit_text("-------------\n");
+        emit_text("Structure        Objects   Live bytes   Peak bytes\n");
+        emit_text("=============== ======== ============ ============\n");
+        for (int i = 0; i < MEM_KINDS; i++){
+                emit_memory_row(names[i], mem_usage[i].live_count, mem_usage[i].live_bytes, mem_usage[i].peak_bytes);
+                total_count += mem_usage[i].live_count;
+                total_bytes += mem_usage[i].live_bytes;
+                total_overhead += mem_usage[i].overhead_bytes;
+        }
+        if (output_format == FORMAT_TEXT){
+                fprintf(stdout, "%-15s %8s %12zu\n", "malloc overhead", "", total_overhead);
+        }
+        else{
+                emit_memory_row("malloc overhead", 0, total_overhead, 0);
+        }
+        emit_memory_row("total", total_count, total_bytes + total_overhead, mem_peak);
+        if (output_format == FORMAT_TEXT){
+                fprintf(stdout, "%-15s %8zu\n", "allocations", mem_allocations);
+        }
+        else{
+                emit_memory_row("allocations", mem_allocations, 0, 0);
+        }
+        if (output_format != FORMAT_TEXT){
+                record_begin(&output_record, RECORD_MEMORY_LIMIT);
+                record_number(&output_record, "limit", mem_limit);
+                record_end(&output_record);
+                record_write(&output_record);
+        }
+        else if (mem_limit == 0){
+                fprintf(stdout, "memory limit: none\n");
+        }
+        else{
+                fprintf(stdout, "memory limit: %zu\n", mem_limit);
+        }
+}
+
+void memory_limit(size_t limit){
+        mem_limit = limit;
+}
+
+void help(){
+        // copied and pasted from website, all commands
+        emit_text("Requests:\n");
+        emit_help("addPart");
+        emit_help("addAssembly ID capacity [x1 n1 [x2 n2 ...]]");
+        emit_help("importParts file");
+        emit_help("importAssemblies file");
+        emit_help("reloadCatalog file");
+        emit_help("fulfillOrder [x1 n1 [x2 n2 ...]]");
+        emit_help("stock ID n");
+        emit_help("restock [ID]");
+        emit_help("empty ID");
+        emit_help("inventory [ID]");
+        emit_help("inventory --since n");
+        emit_help("subscribe file [low]");
+        emit_help("unsubscribe file");
+        emit_help("parts");
+        emit_help("memory [limit bytes]");
+        emit_help("reserve [x1 n1 [x2 n2 ...]] ttl");
+        emit_help("commit RID");
+        emit_help("release RID");
+        emit_help("budget n");
+        emit_help("simulate file");
+        emit_help("format text|jsonl|binary");
+        emit_help("makeReport each|aggregate|summary");
+        emit_help("trace file|off");
+        emit_help("help");
+        emit_help("clear");
+        emit_help("quit");
+}
+
+void clear(){
+        // reservations point at the assemblies about to be freed
+        reservations_clear();
+        catalog_free(&inv);
+
+        // the logged changes point at the assemblies that were just freed
+        feed_reset();
+        catalog_reclaim(1);
+        if (replication.role == REPLICATION_PRIMARY){
+                journal_append(JOURNAL_CLEAR, "", 0, NULL);
+        }
+}
+
+void catalog_free(inventory_t * invp){
+        // clearing parts and resetting count
+        part_t * current_part = invp->part_list;
+        while (current_part != NULL){
+                part_t * temp = current_part;
+                current_part = current_part->next;
+                mem_free(MEM_PART, temp, sizeof(part_t));
+        }
+        invp->part_list = NULL;
+        invp->part_tail = NULL;
+        invp->part_count = 0;
+        index_clear(&invp->part_index);
+        mem_free(MEM_INDEX, invp->part_table, invp->part_table_capacity * sizeof(part_t *));
+        invp->part_table = NULL;
+        invp->part_table_capacity = 0;
+
+        // clearing assemblies and resetting count
+        assembly_t * current_assembly = invp->assembly_list;
+        while (current_assembly != NULL){
+                assembly_t * temp_assembly = current_assembly;
+                current_assembly = current_assembly->next;
+                assembly_free(temp_assembly);
+        }
+        invp->assembly_list = NULL;
+        invp->assembly_tail = NULL;
+        invp->assembly_count = 0;
+        index_clear(&invp->assembly_index);
+}
+
+void assembly_free(assembly_t * assembly){
+        // freeing items needed list
+        unit_demand_free(assembly->unit, assembly->items->item_count);
+        free_items(assembly->items);
+        mem_free(MEM_ASSEMBLY, assembly, sizeof(assembly_t));
+}
+
+void quit(){
+        // the builder thread reads the partition count, and a published catalog is journaled
+        catalog_stop();
+        partition_stop();
+        replication_stop();
+        trace_stop();
+        clear();
+        undo_free(&order_undo);
+        workspace_free(&workspace);
+        parallel_restock_free();
+        record_free(&output_record);
+        capture_stop();
+        replay_stop();
+        exit(EXIT_SUCCESS);
+}
+
+// things related to manufacturing
+int make(inventory_t * invp, assembly_t * assembly, long long n, demand_t * parts){
+        // basic checks
+        if (n <= 0){
+                return 0;
+        }
+        PROBE2(make, assembly->id, n);
+        if (!tracing){
+                return make_units(invp, assembly, n, parts);
+        }
+
+        trace_event('B', TRACE_MAKE, assembly, n, n);
+        int result = make_units(invp, assembly, n, parts);
+        trace_event('E', TRACE_MAKE, assembly, n, n);
+        return result;
+}
+
+// make() without the tracing, for n > 0
+int make_units(inventory_t * invp, assembly_t * assembly, long long n, demand_t * parts){
+        // a big explosion with nothing in stock below it doesn't depend on on_hand, so it can be spread across threads
+        // (not in a fork or a restock lane: those already have a thread each; nor when some of it is held by another partition)
+        if (assembly->tree_nodes >= PARALLEL_MIN_NODES && parts->fork == NULL && !parts->threaded && assembly->partition_local){
+                int workers = worker_count(assembly->tree_nodes, EXPLODE_GRAIN);
+                if (workers > 1 && subtree_unstocked(invp, assembly, ++visit_mark)){
+                        return make_parallel(invp, assembly, n, parts, workers);
+                }
+        }
+
+        if (make_report != MAKE_REPORT_EACH && parts->fork == NULL){
+                demand_add_made(parts, assembly, n);
+        }
+        else if (parts->undo != NULL){
+                struct record * line = &parts->undo->line;
+                format_make(line, assembly, n);
+                if (line->failed){
+                        parts->undo->held.failed = 1;
+                }
+                record_bytes(&parts->undo->held, line->data, line->length);
+        }
+        else if (parts->fork == NULL){
+                emit_make(assembly, n);
+        }
+
+        // the recipe, resolved to part indexes and sub-assembly pointers the first time it is made
+        unit_demand_t * unit = assembly->unit;
+        if (unit == NULL){
+                unit = unit_demand_build(invp, assembly);
+                if (unit == NULL){
+                        report_error("Memory allocation failed");
+                        parts->overflow = 1;
+                        return -1;
+                }
+        }
+
+        // the parts, all at once
+        if (demand_add_unit(parts, assembly, n) != 0){
+                return -1;
+        }
+
+        // the sub-assemblies, in the same (reverse recipe) order as always
+        for (int i = 0; i < unit->assembly_count; i++){
+                long long quantity;
+                if (mul_overflows(n, unit->assembly_quantity[i], &quantity)){
+                        parts->overflow = 1;
+                        return -1;
+                }
+                if (get(invp, unit->assemblies[i], quantity, parts) != 0){
+                        return -1;
+                }
+        }
+        return 0;
+}
+
+int get(inventory_t * invp, assembly_t * assembly, long long n, demand_t * parts){
+        // basic checks
+        if (n <= 0){
+                return 0;
+        }
+
+        // stock another partition holds is asked for there
+        if (partitions.count > 0 && assembly->partition != partitions.self){
+                return partition_get(assembly, n, parts);
+        }
+
+        // reserved stock stays where it is
+        long long on_hand = on_hand_of(parts, assembly);
+        long long available = on_hand > assembly->reserved ? on_hand - assembly->reserved : 0;
+        long long remaining_quantity = available >= n ? 0 : n - available;
+        PROBE3(get, assembly->id, n, remaining_quantity);
+        if (tracing){
+                trace_event('B', TRACE_GET, assembly, n, remaining_quantity);
+        }
+
+        int result;
+        if (remaining_quantity == 0){
+                result = change_on_hand(parts, assembly, on_hand - n);
+        }
+        else if (make(invp, assembly, remaining_quantity, parts) != 0){
+                result = -1;
+        }
+        else{
+                result = change_on_hand(parts, assembly, on_hand - available);
+        }
+
+        if (tracing){
+                trace_event('E', TRACE_GET, assembly, n, remaining_quantity);
+        }
+        return result;
+}
+
+// things related to reservations
+long long available_of(demand_t * parts, assembly_t * assembly){
+        long long on_hand = on_hand_of(parts, assembly);
+        return on_hand > assembly->reserved ? on_hand - assembly->reserved : 0;
+}
+
+void reserve(char * order){
+        // the order's lines, then the ttl
+        char * tokens[MAX_LINE_LENGTH / 2];
+        int token_count = 0;
+        for (char * token = strtok(order, " "); token != NULL && token_count < MAX_LINE_LENGTH / 2; token = strtok(NULL, " ")){
+                tokens[token_count++] = token;
+        }
+        if (token_count < 3 || token_count % 2 == 0){
+                report_error("Invalid input");
+                return;
+        }
+        char * ttl_string = tokens[token_count - 1];
+        char * end;
+        long long ttl = strtoll(ttl_string, &end, 10);
+        if (ttl <= 0 || ttl > RESERVATION_TTL_MAX || *end != '\0'){
+                report_error("%s: illegal reservation ttl", ttl_string);
+                return;
+        }
+
+        // the same checks as fulfillOrder, with repeated IDs added together
+        items_needed_t * items = mem_calloc(MEM_ITEMS_NEEDED, 1, sizeof(items_needed_t));
+        if (items == NULL){
+                report_error("Memory allocation failed");
+                return;
+        }
+        for (int i = 0; i < token_count - 1; i += 2){
+                char * id = tokens[i];
+                long long quantity = atoll(tokens[i + 1]);
+                if (id[0] != 'A' || find_assembly(&inv, id) == NULL){
+                        report_error("%s: assembly ID is not in the inventory -- reservation canceled", id);
+                        free_items(items);
+                        return;
+                }
+                if (quantity <= 0){
+                        report_error("%lld: illegal order quantity for ID %s -- reservation canceled", quantity, id);
+                        free_items(items);
+                        return;
+                }
+                if (add_item(items, id, quantity) != 0){
+                        report_error("%s: quantity overflow -- reservation canceled", id);
+                        free_items(items);
+                        return;
+                }
+        }
+
+        // nothing is made for a reservation, so everything has to be on hand already
+        for (item_t * item = items->item_list; item != NULL; item = item->next){
+                assembly_t * assembly = find_assembly(&inv, item->id);
+                long long available = assembly->on_hand > assembly->reserved ? assembly->on_hand - assembly->reserved : 0;
+                if (available < item->quantity){
+                        report_error("%s: only %lld available -- reservation canceled", item->id, available);
+                        free_items(items);
+                        return;
+                }
+        }
+
+        struct reservation * reservation = mem_calloc(MEM_RESERVATION, 1, sizeof(struct reservation));
+        struct reservation_line * lines = mem_alloc(MEM_RESERVATION, items->item_count * sizeof(struct reservation_line));
+        if (reservation == NULL || lines == NULL || reservation_link(reservation) != 0){
+                report_error("Memory allocation failed");
+                mem_free(MEM_RESERVATION, reservation, sizeof(struct reservation));
+                mem_free(MEM_RESERVATION, lines, items->item_count * sizeof(struct reservation_line));
+                free_items(items);
+                return;
+        }
+        int line_count = 0;
+        for (item_t * item = items->item_list; item != NULL; item = item->next){
+                assembly_t * assembly = find_assembly(&inv, item->id);
+                assembly->reserved += item->quantity;
+                lines[line_count].assembly = assembly;
+                lines[line_count].quantity = item->quantity;
+                line_count++;
+        }
+        free_items(items);
+
+        reservation->lines = lines;
+        reservation->line_count = line_count;
+        reservation->expires = reservations.now + ttl;
+        wheel_insert(reservation);
+        emit_reservation(reservation->id, "reserved", ttl);
+}
+
+void commit_reservation(char * rid){
+        struct reservation * reservation = reservation_find(rid);
+        if (reservation == NULL){
+                report_error("%s: no such reservation", rid);
+                return;
+        }
+        wheel_remove(reservation);
+        reservation_end(reservation, "committed", 1);
+}
+
+void release_reservation(char * rid){
+        struct reservation * reservation = reservation_find(rid);
+        if (reservation == NULL){
+                report_error("%s: no such reservation", rid);
+                return;
+        }
+        wheel_remove(reservation);
+        reservation_end(reservation, "released", 0);
+}
+
+// files a reservation on the lowest level whose slots reach its expiry
+void wheel_insert(struct reservation * reservation){
+        unsigned long delta = reservation->expires - reservations.now;
+        int level = 0;
+        while (level < WHEEL_LEVELS - 1 && delta >= (1UL << ((level + 1) * WHEEL_SLOT_BITS))){
+                level++;
+        }
+        int slot = (reservation->expires >> (level * WHEEL_SLOT_BITS)) & (WHEEL_SLOTS - 1);
+
+        reservation->level = level;
+        reservation->slot = slot;
+        reservation->prev = NULL;
+        reservation->next = reservations.slots[level][slot];
+        if (reservation->next != NULL){
+                reservation->next->prev = reservation;
+        }
+        reservations.slots[level][slot] = reservation;
+}
+
+void wheel_remove(struct reservation * reservation){
+        if (reservation->prev != NULL){
+                reservation->prev->next = reservation->next;
+        }
+        else{
+                reservations.slots[reservation->level][reservation->slot] = reservation->next;
+        }
+        if (reservation->next != NULL){
+                reservation->next->prev = reservation->prev;
+        }
+}
+
+// moves the wheel up to the current second, expiring whatever comes due; called before each request
+void wheel_advance(){
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (!reservations.started){
+                reservations.start = now;
+                reservations.started = 1;
+        }
+        unsigned long target = now.tv_sec - reservations.start.tv_sec;
+
+        // with nothing filed, there's nothing to step through
+        if (reservations.count == 0){
+                reservations.now = target;
+                return;
+        }
+
+        while (reservations.now < target){
+                reservations.now++;
+
+                // each time a level wraps around, the next level's current slot is refiled further down
+                for (int level = 1; level < WHEEL_LEVELS; level++){
+                        if (((reservations.now >> ((level - 1) * WHEEL_SLOT_BITS)) & (WHEEL_SLOTS - 1)) != 0){
+                                break;
+                        }
+                        int slot = (reservations.now >> (level * WHEEL_SLOT_BITS)) & (WHEEL_SLOTS - 1);
+                        struct reservation * reservation = reservations.slots[level][slot];
+                        reservations.slots[level][slot] = NULL;
+                        while (reservation != NULL){
+                                struct reservation * next = reservation->next;
+                                wheel_insert(reservation);
+                                reservation = next;
+                        }
+                }
+
+                int slot = reservations.now & (WHEEL_SLOTS - 1);
+                struct reservation * reservation = reservations.slots[0][slot];
+                reservations.slots[0][slot] = NULL;
+                while (reservation != NULL){
+                        struct reservation * next = reservation->next;
+                        reservation_end(reservation, "expired", 0);
+                        reservation = next;
+                }
+        }
+}
+
+// "rid" is "R" followed by the reservation's number
+struct reservation * reservation_find(char * rid){
+        char * end;
+        if (rid == NULL || rid[0] != 'R' || reservations.bucket_count == 0){
+                return NULL;
+        }
+        long id = strtol(rid + 1, &end, 10);
+        if (end == rid + 1 || *end != '\0'){
+                return NULL;
+        }
+        struct reservation * reservation = reservations.buckets[id & (reservations.bucket_count - 1)];
+        while (reservation != NULL && reservation->id != id){
+                reservation = reservation->hash_next;
+        }
+        return reservation;
+}
+
+// gives the reservation the next ID and adds it to the ID table
+int reservation_link(struct reservation * reservation){
+        if (reservations.count == reservations.bucket_count){
+                size_t bucket_count = reservations.bucket_count == 0 ? 64 : reservations.bucket_count * 2;
+                struct reservation ** buckets = mem_calloc(MEM_RESERVATION, bucket_count, sizeof(struct reservation *));
+                if (buckets == NULL){
+                        return -1;
+                }
+                for (size_t i = 0; i < reservations.bucket_count; i++){
+                        struct reservation * current = reservations.buckets[i];
+                        while (current != NULL){
+                                struct reservation * next = current->hash_next;
+                                current->hash_next = buckets[current->id & (bucket_count - 1)];
+                                buckets[current->id & (bucket_count - 1)] = current;
+                                current = next;
+                        }
+                }
+                mem_free(MEM_RESERVATION, reservations.buckets, reservations.bucket_count * sizeof(struct reservation *));
+                reservations.buckets = buckets;
+                reservations.bucket_count = bucket_count;
+        }
+        reservation->id = reservations.next_id++;
+        struct reservation ** bucket = &reservations.buckets[reservation->id & (reservations.bucket_count - 1)];
+        reservation->hash_next = *bucket;
+        *bucket = reservation;
+        reservations.count++;
+        return 0;
+}
+
+void reservation_unlink(struct reservation * reservation){
+        struct reservation ** link = &reservations.buckets[reservation->id & (reservations.bucket_count - 1)];
+        while (*link != reservation){
+                link = &(*link)->hash_next;
+        }
+        *link = reservation->hash_next;
+        reservations.count--;
+}
+
+// gives back (or, if "consume", takes) what the reservation held, then frees it; it must already be off the wheel
+void reservation_end(struct reservation * reservation, char * state, int consume){
+        for (int i = 0; i < reservation->line_count; i++){
+                assembly_t * assembly = reservation->lines[i].assembly;
+                long long quantity = reservation->lines[i].quantity;
+                assembly->reserved -= quantity;
+                if (consume){
+                        // "empty" may have taken stock out from under the reservation
+                        set_on_hand(assembly, assembly->on_hand > quantity ? assembly->on_hand - quantity : 0);
+                }
+        }
+        reservation_unlink(reservation);
+        emit_reservation(reservation->id, state, 0);
+        mem_free(MEM_RESERVATION, reservation->lines, reservation->line_count * sizeof(struct reservation_line));
+        mem_free(MEM_RESERVATION, reservation, sizeof(struct reservation));
+}
+
+// drops every reservation without a word, for clear()
+void reservations_clear(){
+        for (int level = 0; level < WHEEL_LEVELS; level++){
+                for (int slot = 0; slot < WHEEL_SLOTS; slot++){
+                        struct reservation * reservation = reservations.slots[level][slot];
+                        while (reservation != NULL){
+                                struct reservation * next = reservation->next;
+                                mem_free(MEM_RESERVATION, reservation->lines, reservation->line_count * sizeof(struct reservation_line));
+                                mem_free(MEM_RESERVATION, reservation, sizeof(struct reservation));
+                                reservation = next;
+                        }
+                        reservations.slots[level][slot] = NULL;
+                }
+        }
+        mem_free(MEM_RESERVATION, reservations.buckets, reservations.bucket_count * sizeof(struct reservation *));
+        reservations.buckets = NULL;
+        reservations.bucket_count = 0;
+        reservations.count = 0;
+}
+
+// things related to order transactions
+void undo_begin(struct undo_log * undo){
+        undo->count = 0;
+        undo->failed = 0;
+        undo->held.length = 0;
+        undo->held.failed = 0;
+}
+
+// applies the change straight to the assembly, remembering what it was
+int undo_record(struct undo_log * undo, assembly_t * assembly, long long on_hand){
+        if (grow_array(MEM_SCRATCH, (void **)&undo->entries, &undo->capacity, undo->count + 1, sizeof(struct undo_entry), 64) != 0){
+                undo->failed = 1;
+                return -1;
+        }
+        struct undo_entry * entry = &undo->entries[undo->count++];
+        entry->assembly = assembly;
+        entry->old_on_hand = assembly->on_hand;
+        entry->new_on_hand = on_hand;
+        assembly->on_hand = on_hand;
+        return 0;
+}
+
+void undo_commit(struct undo_log * undo){
+        // replaying each change through set_on_hand(), so the change feed sees exactly what it would have
+        for (int i = 0; i < undo->count; i++){
+                struct undo_entry * entry = &undo->entries[i];
+                entry->assembly->on_hand = entry->old_on_hand;
+                set_on_hand(entry->assembly, entry->new_on_hand);
+        }
+        // nothing is held when the order came entirely from stock, and then there is no buffer to write from
+        if (undo->held.length > 0){
+                fwrite(undo->held.data, 1, undo->held.length, stdout);
+        }
+        undo_begin(undo);
+        partition_settle(1);
+}
+
+void undo_rollback(struct undo_log * undo){
+        for (int i = undo->count - 1; i >= 0; i--){
+                undo->entries[i].assembly->on_hand = undo->entries[i].old_on_hand;
+        }
+        undo_begin(undo);
+        partition_settle(0);
+}
+
+void undo_free(struct undo_log * undo){
+        mem_free(MEM_SCRATCH, undo->entries, undo->capacity * sizeof(struct undo_entry));
+        undo->entries = NULL;
+        undo->count = 0;
+        undo->capacity = 0;
+        record_free(&undo->held);
+        record_free(&undo->line);
+}
+
+// all the part quantities added up, or LLONG_MAX if that overflows
+long long demand_total(demand_t * parts){
+        long long total = 0;
+        for (int i = 0; i < parts->touched_count; i++){
+                long long quantity = parts->quantity[parts->touched[i]];
+                if (quantity > LLONG_MAX - total){
+                        return LLONG_MAX;
+                }
+                total += quantity;
+        }
+        return total;
+}
+
+void parts_budget(long long budget){
+        order_budget = budget;
+}
+
+// things related to simulation
+long long on_hand_of(demand_t * parts, assembly_t * assembly){
+        struct inventory_fork * fork = parts->fork;
+        if (fork != NULL && fork->count > 0){
+                size_t slot = fork_slot(fork, assembly);
+                if (fork->assemblies[slot] != NULL){
+                        return fork->on_hand[slot];
+                }
+        }
+        return assembly->on_hand;
+}
+
+// set_on_hand() for the real inventory; in a fork, the change stays in the fork; returns -1 if it was lost
+int change_on_hand(demand_t * parts, assembly_t * assembly, long long on_hand){
+        if (parts->undo != NULL){
+                return undo_record(parts->undo, assembly, on_hand);
+        }
+        if (parts->fork == NULL){
+                set_on_hand(assembly, on_hand);
+                return 0;
+        }
+        return fork_set_on_hand(parts->fork, assembly, on_hand);
+}
+
+// the slot holding "assembly", or the empty slot where it would go; the table must have been allocated
+size_t fork_slot(struct inventory_fork * fork, assembly_t * assembly){
+        size_t mask = fork->capacity - 1;
+        size_t slot = ((size_t)assembly->index * 2654435761u) & mask;
+        while (fork->assemblies[slot] != NULL && fork->assemblies[slot] != assembly){
+                slot = (slot + 1) & mask;
+        }
+        return slot;
+}
+
+int fork_set_on_hand(struct inventory_fork * fork, assembly_t * assembly, long long on_hand){
+        // kept at most half full
+        if ((fork->count + 1) * 2 > fork->capacity){
+                size_t capacity = fork->capacity == 0 ? 16 : fork->capacity * 2;
+                assembly_t ** assemblies = mem_calloc(MEM_SCRATCH, capacity, sizeof(assembly_t *));
+                long long * values = mem_alloc(MEM_SCRATCH, capacity * sizeof(long long));
+                if (assemblies == NULL || values == NULL){
+                        mem_free(MEM_SCRATCH, assemblies, capacity * sizeof(assembly_t *));
+                        mem_free(MEM_SCRATCH, values, capacity * sizeof(long long));
+                        fork->failed = 1;
+                        return -1;
+                }
+                struct inventory_fork bigger = {.assemblies = assemblies, .on_hand = values, .capacity = capacity, .count = fork->count, .failed = 0};
+                for (size_t i = 0; i < fork->capacity; i++){
+                        if (fork->assemblies[i] != NULL){
+                                size_t slot = fork_slot(&bigger, fork->assemblies[i]);
+                                bigger.assemblies[slot] = fork->assemblies[i];
+                                bigger.on_hand[slot] = fork->on_hand[i];
+                        }
+                }
+                fork_free(fork);
+                *fork = bigger;
+        }
+
+        size_t slot = fork_slot(fork, assembly);
+        if (fork->assemblies[slot] == NULL){
+                fork->assemblies[slot] = assembly;
+                fork->count++;
+        }
+        fork->on_hand[slot] = on_hand;
+        return 0;
+}
+
+void fork_free(struct inventory_fork * fork){
+        mem_free(MEM_SCRATCH, fork->assemblies, fork->capacity * sizeof(assembly_t *));
+        mem_free(MEM_SCRATCH, fork->on_hand, fork->capacity * sizeof(long long));
+        fork->assemblies = NULL;
+        fork->on_hand = NULL;
+        fork->capacity = 0;
+        fork->count = 0;
+}
+
+void simulate(inventory_t * invp, char * filename){
+        size_t size;
+        char * text = read_file(filename, &size);
+        if (text == NULL){
+                return;
+        }
+
+        // one scenario per line, skipping blank lines and comments like the request stream does
+        int count = 0;
+        size_t capacity = 0;
+        char ** lines = NULL;
+        char * cursor = text;
+        while (*cursor != '\0'){
+                char * line = cursor;
+                char * newline = strchr(cursor, '\n');
+                if (newline != NULL){
+                        *newline = '\0';
+                        cursor = newline + 1;
+                }
+                else{
+                        cursor += strlen(cursor);
+                }
+                char * comment_pos = strchr(line, '#');
+                if (comment_pos != NULL){
+                        *comment_pos = '\0';
+                }
+                line = trim(line);
+                if (strlen(line) == 0){
+                        continue;
+                }
+                if (grow_array(MEM_SCRATCH, (void **)&lines, &capacity, count + 1, sizeof(char *), 64) != 0){
+                        report_error("Memory allocation failed");
+                        mem_free(MEM_SCRATCH, lines, capacity * sizeof(char *));
+                        mem_free(MEM_SCRATCH, text, size);
+                        return;
+                }
+                lines[count++] = line;
+        }
+
+        // scenarios only read the catalog, so every recipe is resolved before any of them start
+        struct simulation simulation = {.invp = invp, .scenarios = NULL, .next = 0, .end = 0, .assembly_array = NULL};
+        int ready = 1;
+        for (assembly_t * assembly = invp->assembly_list; assembly != NULL; assembly = assembly->next){
+                if (assembly->unit == NULL && unit_demand_build(invp, assembly) == NULL){
+                        ready = 0;
+                }
+        }
+        if (invp->assembly_count > 0){
+                simulation.assembly_array = to_assembly_array(invp->assembly_count, invp->assembly_list);
+                if (simulation.assembly_array == NULL){
+                        ready = 0;
+                }
+        }
+        simulation.scenarios = mem_alloc(MEM_SCRATCH, SIMULATE_BATCH * sizeof(struct scenario));
+        if (!ready || simulation.scenarios == NULL){
+                report_error("Memory allocation failed");
+                count = 0;
+        }
+
+        // in batches, so only SIMULATE_BATCH results are held at once
+        for (int first = 0; first < count; first += SIMULATE_BATCH){
+                int batch = count - first < SIMULATE_BATCH ? count - first : SIMULATE_BATCH;
+                for (int i = 0; i < batch; i++){
+                        struct scenario * scenario = &simulation.scenarios[i];
+                        scenario->text = lines[first + i];
+                        scenario->parts = NULL;
+                        memset(&scenario->fork, 0, sizeof(scenario->fork));
+                        scenario->error[0] = '\0';
+                }
+                simulation.next = 0;
+                simulation.end = batch;
+
+                pthread_t threads[MAX_WORKERS];
+                int started[MAX_WORKERS] = {0};
+                int workers = worker_count(batch, 1);
+                for (int i = 1; i < workers; i++){
+                        started[i] = pthread_create(&threads[i], NULL, simulate_work, &simulation) == 0;
+                }
+                simulate_work(&simulation);
+                for (int i = 1; i < workers; i++){
+                        if (started[i]){
+                                pthread_join(threads[i], NULL);
+                        }
+                }
+
+                for (int i = 0; i < batch; i++){
+                        struct scenario * scenario = &simulation.scenarios[i];
+                        simulate_report(invp, scenario, first + i + 1);
+                        demand_free(scenario->parts);
+                        fork_free(&scenario->fork);
+                }
+        }
+
+        mem_free(MEM_SCRATCH, simulation.scenarios, SIMULATE_BATCH * sizeof(struct scenario));
+        mem_free(MEM_SCRATCH, simulation.assembly_array, invp->assembly_count * sizeof(assembly_t *));
+        mem_free(MEM_SCRATCH, lines, capacity * sizeof(char *));
+        mem_free(MEM_SCRATCH, text, size);
+}
+
+void * simulate_work(void * arg){
+        struct simulation * simulation = arg;
+        while (1){
+                int i = __atomic_fetch_add(&simulation->next, 1, __ATOMIC_SEQ_CST);
+                if (i >= simulation->end){
+                        break;
+                }
+                simulate_scenario(simulation, &simulation->scenarios[i]);
+        }
+        return NULL;
+}
+
+void simulate_scenario(struct simulation * simulation, struct scenario * scenario){
+        scenario->parts = demand_create(simulation->invp);
+        size_t length = strlen(scenario->text) + 1;
+        char * text = mem_alloc(MEM_SCRATCH, length); // tokenized, while "scenario->text" is kept for the report
+        if (scenario->parts == NULL || text == NULL){
+                snprintf(scenario->error, sizeof(scenario->error), "Memory allocation failed");
+                mem_free(MEM_SCRATCH, text, length);
+                return;
+        }
+        scenario->parts->fork = &scenario->fork;
+        memcpy(text, scenario->text, length);
+
+        char * save;
+        for (char * command = strtok_r(text, ";", &save); command != NULL; command = strtok_r(NULL, ";", &save)){
+                if (simulate_command(simulation, scenario, command) != 0){
+                        break;
+                }
+                if (scenario->parts->overflow){
+                        snprintf(scenario->error, sizeof(scenario->error), "quantity overflow -- parts list unavailable");
+                        break;
+                }
+                if (scenario->fork.failed){
+                        snprintf(scenario->error, sizeof(scenario->error), "Memory allocation failed");
+                        break;
+                }
+        }
+        mem_free(MEM_SCRATCH, text, length);
+}
+
+// one request of a scenario, against the scenario's fork; returns -1 (with "scenario->error" set) if it was refused
+int simulate_command(struct simulation * simulation, struct scenario * scenario, char * command){
+        inventory_t * invp = simulation->invp;
+        demand_t * parts = scenario->parts;
+        char * save;
+        char * request = strtok_r(command, " \t", &save);
+        if (request == NULL){
+                return 0;
+        }
+
+        if (strcmp(request, "fulfillOrder") == 0){
+                items_needed_t * items = mem_calloc(MEM_ITEMS_NEEDED, 1, sizeof(items_needed_t));
+                if (items == NULL){
+                        snprintf(scenario->error, sizeof(scenario->error), "Memory allocation failed");
+                        return -1;
+                }
+                char * id;
+                while ((id = strtok_r(NULL, " \t", &save)) != NULL){
+                        char * string_quantity = strtok_r(NULL, " \t", &save);
+                        long long quantity = string_quantity == NULL ? 0 : atoll(string_quantity);
+                        if (string_quantity == NULL){
+                                snprintf(scenario->error, sizeof(scenario->error), "Invalid input");
+                        }
+                        else if (id[0] != 'A' || find_assembly(invp, id) == NULL){
+                                snprintf(scenario->error, sizeof(scenario->error), "%s: assembly ID is not in the inventory -- order canceled", id);
+                        }
+                        else if (quantity <= 0){
+                                snprintf(scenario->error, sizeof(scenario->error), "%lld: illegal order quantity for ID %s -- order canceled", quantity, id);
+                        }
+                        else if (add_item(items, id, quantity) != 0){
+                                snprintf(scenario->error, sizeof(scenario->error), "%s: quantity overflow -- order canceled", id);
+                        }
+                        if (scenario->error[0] != '\0'){
+                                free_items(items);
+                                return -1;
+                        }
+                }
+                for (item_t * item = items->item_list; item != NULL; item = item->next){
+                        if (get(invp, find_assembly(invp, item->id), item->quantity, parts) != 0){
+                                break;
+                        }
+                }
+                free_items(items);
+                return 0;
+        }
+
+        char * id = strtok_r(NULL, " \t", &save);
+        if (strcmp(request, "restock") == 0 && id == NULL){
+                // every low assembly, in the same (reverse list) order as the real restock
+                for (int i = invp->assembly_count - 1; i >= 0; i--){
+                        assembly_t * assembly = simulation->assembly_array[i];
+                        long long on_hand = on_hand_of(parts, assembly);
+                        if (is_low(on_hand, assembly->capacity)){
+                                if (make(invp, assembly, assembly->capacity - on_hand, parts) != 0){
+                                        break;
+                                }
+                                change_on_hand(parts, assembly, assembly->capacity);
+                        }
+                }
+                return 0;
+        }
+
+        // the rest name one assembly
+        if (strcmp(request, "stock") != 0 && strcmp(request, "restock") != 0 && strcmp(request, "empty") != 0){
+                snprintf(scenario->error, sizeof(scenario->error), "%s: unknown command", request);
+                return -1;
+        }
+        if (id == NULL){
+                snprintf(scenario->error, sizeof(scenario->error), "Invalid input");
+                return -1;
+        }
+        assembly_t * assembly = id[0] == 'A' ? find_assembly(invp, id) : NULL;
+        if (assembly == NULL){
+                snprintf(scenario->error, sizeof(scenario->error), "%s: assembly ID is not in the inventory", id);
+                return -1;
+        }
+        long long on_hand = on_hand_of(parts, assembly);
+
+        if (strcmp(request, "stock") == 0){
+                char * string_quantity = strtok_r(NULL, " \t", &save);
+                long long n = string_quantity == NULL ? 0 : atoll(string_quantity);
+                if (n <= 0){
+                        snprintf(scenario->error, sizeof(scenario->error), "%lld: illegal quantity for ID %s", n, id);
+                        return -1;
+                }
+                // only up to capacity, as with the real stock
+                if (n > assembly->capacity - on_hand){
+                        n = assembly->capacity - on_hand;
+                }
+                if (make(invp, assembly, n, parts) == 0){
+                        change_on_hand(parts, assembly, on_hand + n);
+                }
+        }
+        else if (strcmp(request, "restock") == 0){
+                if (is_low(on_hand, assembly->capacity) && make(invp, assembly, assembly->capacity - on_hand, parts) == 0){
+                        change_on_hand(parts, assembly, assembly->capacity);
+                }
+        }
+        else{
+                change_on_hand(parts, assembly, 0);
+        }
+        return 0;
+}
+
+// a scenario's result, in the same shapes as the real requests' results
+void simulate_report(inventory_t * invp, struct scenario * scenario, int number){
+        emit_scenario(number, scenario->text);
+        if (scenario->error[0] != '\0'){
+                report_error("scenario %d: %s", number, scenario->error);
+                return;
+        }
+        print_parts_needed(invp, scenario->parts);
+
+        struct inventory_fork * fork = &scenario->fork;
+        if (fork->count == 0){
+                return;
+        }
+        assembly_t ** assembly_array = mem_alloc(MEM_SCRATCH, fork->count * sizeof(assembly_t *));
+        if (assembly_array == NULL){
+                report_error("Memory allocation failed");
+                return;
+        }
+        int count = 0;
+        for (size_t i = 0; i < fork->capacity; i++){
+                if (fork->assemblies[i] != NULL){
+                        assembly_array[count++] = fork->assemblies[i];
+                }
+        }
+        qsort(assembly_array, count, sizeof(assembly_t *), assembly_compare);
+
+        emit_text("Ending stock:\n");
+        emit_text("-------------\n");
+        emit_inventory_header();
+        for (int i = 0; i < count; i++){
+                emit_inventory_row(assembly_array[i], fork->on_hand[fork_slot(fork, assembly_array[i])]);
+        }
+        mem_free(MEM_SCRATCH, assembly_array, fork->count * sizeof(assembly_t *));
+}
+
+// things related to partitions
+FILE * partition_start(int count, FILE * fp){
+        // nothing buffered may be written twice, once by each side of a fork
+        fflush(NULL);
+        // a worker that dies shows up as end-of-file rather than a signal
+        signal(SIGPIPE, SIG_IGN);
+
+        partitions.count = count;
+        for (int i = 0; i < count; i++){
+                int fds[2];
+                if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0){
+                        perror("Failed to create partition socket");
+                        return NULL;
+                }
+                pid_t pid = fork();
+                if (pid < 0){
+                        perror("Failed to start partition");
+                        return NULL;
+                }
+                if (pid == 0){
+                        // the coordinator's ends of the earlier workers' sockets
+                        close(fds[0]);
+                        for (int j = 0; j < i; j++){
+                                fclose(partitions.channels[j].in);
+                                fclose(partitions.channels[j].out);
+                        }
+                        return partition_worker(i, fds[1], fp);
+                }
+                close(fds[1]);
+                struct partition_channel * channel = &partitions.channels[i];
+                channel->pid = pid;
+                channel->in = fdopen(fds[0], "r");
+                channel->out = fdopen(dup(fds[0]), "w");
+                channel->open = 0;
+                if (channel->in == NULL || channel->out == NULL){
+                        perror("Failed to open partition socket");
+                        return NULL;
+                }
+        }
+        return fp;
+}
+
+// the worker's side of partition_start(); returns the socket, which the worker reads its requests from
+FILE * partition_worker(int self, int fd, FILE * fp){
+        partitions.self = self;
+        if (fp != stdin){
+                fclose(fp);
+        }
+        partitions.in = fdopen(fd, "r");
+        partitions.out = fdopen(dup(fd), "w");
+
+        // standard output and error go to temporary files, and from there to the coordinator as answers
+        FILE * out = tmpfile();
+        FILE * err = tmpfile();
+        if (partitions.in == NULL || partitions.out == NULL || out == NULL || err == NULL){
+                perror("Failed to start partition");
+                return NULL;
+        }
+        dup2(fileno(out), STDOUT_FILENO);
+        dup2(fileno(err), STDERR_FILENO);
+        fclose(out);
+        fclose(err);
+        // appending, so the files can be cut back after each answer
+        fcntl(STDOUT_FILENO, F_SETFL, O_APPEND);
+        fcntl(STDERR_FILENO, F_SETFL, O_APPEND);
+        return partitions.in;
+}
+
+void partition_stop(){
+        if (partitions.self >= 0){
+                return;
+        }
+        // closing the sockets ends each worker's request loop
+        partition_finish();
+        for (int i = 0; i < partitions.count; i++){
+                fclose(partitions.channels[i].out);
+                fclose(partitions.channels[i].in);
+                waitpid(partitions.channels[i].pid, NULL, 0);
+        }
+        partitions.count = 0;
+}
+
+// which partition holds a new assembly: its first sub-assembly's, so recipes tend to stay inside one partition,
+// or else one picked by hashing its ID
+void place_assembly(inventory_t * invp, assembly_t * assembly){
+        assembly->partition = -1;
+        assembly->partition_local = 1;
+        item_t * current_item = assembly->items->item_list;
+        while (current_item != NULL){
+                if (current_item->id[0] == 'A'){
+                        assembly_t * child = find_assembly(invp, current_item->id);
+                        if (assembly->partition < 0){
+                                assembly->partition = child->partition;
+                        }
+                        if (child->partition != assembly->partition || !child->partition_local){
+                                assembly->partition_local = 0;
+                        }
+                }
+                current_item = current_item->next;
+        }
+        if (assembly->partition < 0){
+                assembly->partition = partitions.count > 0 ? (int)(id_hash(assembly->id) % partitions.count) : 0;
+        }
+}
+
+// the coordinator's part of a request; returns 1 if the request was taken care of, 0 if it is still to be served here
+int partition_route(char * line){
+        char copy[MAX_LINE_LENGTH];
+        strcpy(copy, line);
+        char * save;
+        char * token = strtok_r(copy, " ", &save);
+        char * id = strtok_r(NULL, " ", &save);
+
+        // the catalog and settings are repeated in every worker, and served here too
+        if (strcmp(token, "addPart") == 0 || strcmp(token, "addAssembly") == 0 || strcmp(token, "importParts") == 0 || strcmp(token, "importAssemblies") == 0
+            || strcmp(token, "format") == 0 || strcmp(token, "memory") == 0 || strcmp(token, "clear") == 0){
+                partition_broadcast(line);
+                return 0;
+        }
+
+        // only the owner has the stock; an ID that isn't an assembly is reported here
+        if (strcmp(token, "stock") == 0 || strcmp(token, "empty") == 0 || (strcmp(token, "restock") == 0 && id != NULL)){
+                assembly_t * assembly = id == NULL ? NULL : find_assembly(&inv, id);
+                if (assembly == NULL){
+                        return 0;
+                }
+                struct partition_channel * channel = &partitions.channels[assembly->partition];
+                fprintf(channel->out, "%s\n", line);
+                fflush(channel->out);
+                partition_relay(assembly->partition, PARTITION_COORDINATOR, NULL);
+                return 1;
+        }
+        if (strcmp(token, "restock") == 0){
+                partition_restock_all(&inv);
+                return 1;
+        }
+
+        // listed from the coordinator's catalog, once it has everyone's on_hand
+        if (strcmp(token, "inventory") == 0 && (id == NULL || strcmp(id, "--since") != 0)){
+                partition_refresh();
+                return 0;
+        }
+
+        // these need the stock, or the change feed, in one place
+        if (strcmp(token, "inventory") == 0 || strcmp(token, "subscribe") == 0 || strcmp(token, "unsubscribe") == 0 || strcmp(token, "reserve") == 0
+            || strcmp(token, "commit") == 0 || strcmp(token, "release") == 0 || strcmp(token, "simulate") == 0 || strcmp(token, "trace") == 0
+            || strcmp(token, "makeReport") == 0 || strcmp(token, "reloadCatalog") == 0){
+                report_error("%s: not available with partitions", token);
+                return 1;
+        }
+        return 0;
+}
+
+// sends the request to every worker; the answers are read by partition_finish(), after the coordinator has served
+// the request itself, so they all work on it at once
+void partition_broadcast(char * line){
+        for (int i = 0; i < partitions.count; i++){
+                fprintf(partitions.channels[i].out, "%s\n", line);
+                fflush(partitions.channels[i].out);
+        }
+        partitions.pending = 1;
+}
+
+// copies every worker's on_hand counts into the coordinator's catalog
+void partition_refresh(){
+        for (int i = 0; i < partitions.count; i++){
+                fprintf(partitions.channels[i].out, "partition stock\n");
+                fflush(partitions.channels[i].out);
+        }
+        for (int i = 0; i < partitions.count; i++){
+                partition_relay(i, PARTITION_COORDINATOR, NULL);
+        }
+}
+
+// restock() of every assembly, in the same (LIFO) order, each one by its owner
+void partition_restock_all(inventory_t * invp){
+        demand_t * parts = workspace_demand(&workspace, invp);
+        assembly_t ** assembly_array = (assembly_t **)workspace_sort(&workspace, invp->assembly_count);
+        if (parts == NULL || assembly_array == NULL){
+                report_error("Memory allocation failed");
+                if (parts != NULL){
+                        workspace_release(&workspace, parts);
+                }
+                return;
+        }
+        int count = 0;
+        for (assembly_t * current = invp->assembly_list; current != NULL; current = current->next){
+                assembly_array[count++] = current;
+        }
+
+        for (int i = invp->assembly_count - 1; i >= 0; i--){
+                struct partition_channel * channel = &partitions.channels[assembly_array[i]->partition];
+                fprintf(channel->out, "partition restock %s\n", assembly_array[i]->id);
+                fflush(channel->out);
+                if (partition_relay(assembly_array[i]->partition, PARTITION_COORDINATOR, parts) != 0){
+                        break;
+                }
+        }
+
+        // printing out the parts needed
+        if (parts->overflow){
+                report_error("quantity overflow -- parts list unavailable");
+        }
+        else{
+                print_parts_needed(invp, parts);
+        }
+        workspace_release(&workspace, parts);
+}
+
+// an order whose lines never leave their own partitions: every line is sent before any answer is read, so the workers
+// run them side by side; the answers are still taken in line order. Returns 0 if the order has to go line by line
+int partition_scatter(items_needed_t * items, demand_t * parts){
+        if (partitions.count == 0){
+                return 0;
+        }
+        for (item_t * item = items->item_list; item != NULL; item = item->next){
+                if (!find_assembly(&inv, item->id)->partition_local){
+                        return 0;
+                }
+        }
+
+        for (item_t * item = items->item_list; item != NULL; item = item->next){
+                struct partition_channel * channel = &partitions.channels[find_assembly(&inv, item->id)->partition];
+                fprintf(channel->out, "partition get %s %lld 1\n", item->id, item->quantity);
+                channel->open = 1;
+        }
+        for (int i = 0; i < partitions.count; i++){
+                fflush(partitions.channels[i].out);
+        }
+        // a line that fails doesn't stop the answers to the rest, which are already on their way
+        for (item_t * item = items->item_list; item != NULL; item = item->next){
+                partition_relay(find_assembly(&inv, item->id)->partition, PARTITION_COORDINATOR, parts);
+        }
+        return 1;
+}
+
+// get() of an assembly held by another partition: a worker asks the coordinator, the coordinator asks the owner
+int partition_get(assembly_t * assembly, long long n, demand_t * parts){
+        int txn = parts->undo != NULL;
+        if (partitions.self >= 0){
+                fprintf(partitions.out, "call %s %lld %d\n", assembly->id, n, txn);
+                fflush(partitions.out);
+                return partition_relay(PARTITION_COORDINATOR, PARTITION_COORDINATOR, parts);
+        }
+        struct partition_channel * channel = &partitions.channels[assembly->partition];
+        fprintf(channel->out, "partition get %s %lld %d\n", assembly->id, n, txn);
+        fflush(channel->out);
+        channel->open |= txn;
+        return partition_relay(assembly->partition, PARTITION_COORDINATOR, parts);
+}
+
+// tells every worker that took part in an order whether to keep its changes
+void partition_settle(int commit){
+        if (partitions.self >= 0){
+                return;
+        }
+        for (int i = 0; i < partitions.count; i++){
+                if (partitions.channels[i].open){
+                        fprintf(partitions.channels[i].out, commit ? "partition commit\n" : "partition abort\n");
+                        fflush(partitions.channels[i].out);
+                        partitions.channels[i].open = 0;
+                }
+        }
+}
+
+// reads what "from" sends until it is done with what it was asked. Its answers go on to the worker "to", or into
+// "parts" and this process's output; calls it makes along the way are served (in a worker) or passed on to the owner
+// (in the coordinator). Returns the status "from" was done with
+int partition_relay(int from, int to, demand_t * parts){
+        FILE * in = from == PARTITION_COORDINATOR ? partitions.in : partitions.channels[from].in;
+        FILE * out = to >= 0 ? partitions.channels[to].out : NULL;
+        char header[MAX_LINE_LENGTH];
+        char id[ID_MAX + 1];
+        long long n;
+        int count;
+        int status;
+        int overflow;
+        while (1){
+                if (fgets(header, sizeof(header), in) == NULL){
+                        // nothing more can be done without the other side
+                        if (partitions.self < 0){
+                                report_error("partition %d stopped -- exiting", from);
+                        }
+                        exit(EXIT_FAILURE);
+                }
+
+                if (strncmp(header, "output ", 7) == 0 || strncmp(header, "error ", 6) == 0){
+                        size_t length = strtoull(strchr(header, ' ') + 1, NULL, 10);
+                        char * payload = partition_payload(in, length);
+                        if (out != NULL){
+                                fputs(header, out);
+                                fwrite(payload, 1, length, out);
+                                fflush(out);
+                        }
+                        else if (to == PARTITION_DISCARD){
+                                // already printed by the coordinator
+                        }
+                        else if (header[0] == 'e'){
+                                fwrite(payload, 1, length, stderr);
+                        }
+                        else if (parts != NULL && parts->undo != NULL){
+                                record_bytes(&parts->undo->held, payload, length);
+                        }
+                        else{
+                                fwrite(payload, 1, length, stdout);
+                        }
+                        mem_free(MEM_SCRATCH, payload, length + 1);
+                }
+                else if (sscanf(header, "parts %d", &count) == 1){
+                        if (out != NULL){
+                                fputs(header, out);
+                        }
+                        for (int i = 0; i < count; i++){
+                                if (fgets(header, sizeof(header), in) == NULL){
+                                        exit(EXIT_FAILURE);
+                                }
+                                if (out != NULL){
+                                        fputs(header, out);
+                                }
+                                else if (parts != NULL && sscanf(header, "%11s %lld", id, &n) == 2){
+                                        demand_add_quantity(parts, find_part(&inv, id)->index, n);
+                                }
+                        }
+                        if (out != NULL){
+                                fflush(out);
+                        }
+                }
+                else if (sscanf(header, "stock %d", &count) == 1){
+                        for (int i = 0; i < count; i++){
+                                if (fgets(header, sizeof(header), in) == NULL){
+                                        exit(EXIT_FAILURE);
+                                }
+                                if (sscanf(header, "%11s %lld", id, &n) == 2){
+                                        find_assembly(&inv, id)->on_hand = n;
+                                }
+                        }
+                }
+                else if (sscanf(header, "call %11s %lld %d", id, &n, &status) == 3){
+                        // asked of the owner, with the answer going back to the worker that called
+                        int owner = find_assembly(&inv, id)->partition;
+                        fprintf(partitions.channels[owner].out, "partition get %s %lld %d\n", id, n, status);
+                        fflush(partitions.channels[owner].out);
+                        partitions.channels[owner].open |= status;
+                        partition_relay(owner, from, NULL);
+                }
+                else if (strncmp(header, "partition ", 10) == 0){
+                        header[strcspn(header, "\n")] = '\0';
+                        partition_serve(header + 10);
+                }
+                else if (sscanf(header, "done %d %d", &status, &overflow) == 2){
+                        if (out != NULL){
+                                fputs(header, out);
+                                fflush(out);
+                        }
+                        else if (parts != NULL && status != 0){
+                                // a failure without an overflow is a failed allocation
+                                if (overflow || parts->undo == NULL){
+                                        parts->overflow = 1;
+                                }
+                                else{
+                                        parts->undo->failed = 1;
+                                }
+                        }
+                        return status;
+                }
+        }
+}
+
+char * partition_payload(FILE * in, size_t length){
+        char * payload = mem_alloc(MEM_SCRATCH, length + 1); // never 0 bytes
+        if (payload == NULL || fread(payload, 1, length, in) != length){
+                exit(EXIT_FAILURE);
+        }
+        return payload;
+}
+
+// a worker serving one of the coordinator's "partition" lines
+void partition_serve(char * message){
+        struct partition_mark mark;
+        partition_mark(&mark);
+
+        char * save;
+        char * kind = strtok_r(message, " ", &save);
+        char * id = strtok_r(NULL, " ", &save);
+        assembly_t * assembly = id == NULL ? NULL : find_assembly(&inv, id);
+        if (strcmp(kind, "commit") == 0 || strcmp(kind, "abort") == 0){
+                if (partitions.open){
+                        if (kind[0] == 'c'){
+                                undo_commit(&order_undo);
+                        }
+                        else{
+                                undo_rollback(&order_undo);
+                        }
+                        partitions.open = 0;
+                }
+        }
+        else if (strcmp(kind, "stock") == 0){
+                int count = 0;
+                for (assembly_t * current = inv.assembly_list; current != NULL; current = current->next){
+                        count += current->partition == partitions.self;
+                }
+                fprintf(partitions.out, "stock %d\n", count);
+                for (assembly_t * current = inv.assembly_list; current != NULL; current = current->next){
+                        if (current->partition == partitions.self){
+                                fprintf(partitions.out, "%s %lld\n", current->id, current->on_hand);
+                        }
+                }
+                partition_answer(&mark, NULL, 0);
+        }
+        else if (assembly != NULL && (strcmp(kind, "get") == 0 || strcmp(kind, "restock") == 0)){
+                demand_t * parts = workspace_demand(&workspace, &inv);
+                if (parts == NULL){
+                        report_error("Memory allocation failed");
+                        partition_answer(&mark, NULL, -1);
+                        return;
+                }
+                int status = 0;
+                if (kind[0] == 'g'){
+                        char * string_quantity = strtok_r(NULL, " ", &save);
+                        char * txn = strtok_r(NULL, " ", &save);
+                        // an order's changes are held until the coordinator says how it ended
+                        if (txn != NULL && strcmp(txn, "1") == 0){
+                                if (!partitions.open){
+                                        undo_begin(&order_undo);
+                                        partitions.open = 1;
+                                }
+                                parts->undo = &order_undo;
+                        }
+                        status = get(&inv, assembly, atoll(string_quantity), parts);
+                }
+                else if (is_low(assembly->on_hand, assembly->capacity)){
+                        long long amt_needed = assembly->capacity - assembly->on_hand;
+                        emit_restock(assembly->id, amt_needed);
+                        status = make(&inv, assembly, amt_needed, parts);
+                        if (status == 0){
+                                set_on_hand(assembly, assembly->on_hand + amt_needed);
+                        }
+                }
+                partition_answer(&mark, parts, status);
+                workspace_release(&workspace, parts);
+        }
+        else{
+                partition_answer(&mark, NULL, -1);
+        }
+}
+
+void partition_mark(struct partition_mark * mark){
+        fflush(stdout);
+        mark->out = lseek(STDOUT_FILENO, 0, SEEK_END);
+        mark->err = lseek(STDERR_FILENO, 0, SEEK_END);
+        mark->held = order_undo.held.length;
+}
+
+// sends what was written to "fd" since "from", then cuts the file back to it
+void partition_ship(int fd, char * kind, off_t from){
+        char buffer[4096];
+        off_t end = lseek(fd, 0, SEEK_END);
+        lseek(fd, from, SEEK_SET); // writes still go to the end, since the file is appended to
+        for (off_t offset = from; offset < end; ){
+                ssize_t length = read(fd, buffer, sizeof(buffer));
+                if (length <= 0){
+                        break;
+                }
+                fprintf(partitions.out, "%s %ld\n", kind, (long)length);
+                fwrite(buffer, 1, length, partitions.out);
+                offset += length;
+        }
+        if (end > from && ftruncate(fd, from) != 0){
+                exit(EXIT_FAILURE);
+        }
+}
+
+// a worker's answer to a call or request: the output since "mark", the parts, and how it went
+void partition_answer(struct partition_mark * mark, demand_t * parts, int status){
+        // an order's make events come first, then anything else
+        if (order_undo.held.length > mark->held){
+                fprintf(partitions.out, "output %ld\n", (long)(order_undo.held.length - mark->held));
+                fwrite(order_undo.held.data + mark->held, 1, order_undo.held.length - mark->held, partitions.out);
+                order_undo.held.length = mark->held;
+        }
+        fflush(stdout);
+        partition_ship(STDOUT_FILENO, "output", mark->out);
+        partition_ship(STDERR_FILENO, "error", mark->err);
+
+        if (parts != NULL){
+                fprintf(partitions.out, "parts %d\n", parts->touched_count);
+                for (int i = 0; i < parts->touched_count; i++){
+                        int index = parts->touched[i];
+                        fprintf(partitions.out, "%s %lld\n", inv.part_table[index]->id, parts->quantity[index]);
+                }
+        }
+        fprintf(partitions.out, "done %d %d\n", status, parts != NULL && parts->overflow);
+        fflush(partitions.out);
+}
+
+// once a request has been served: a worker answers it, and the coordinator reads the answers to a broadcast
+// (dropping them, since it printed the same itself)
+void partition_finish(){
+        if (partitions.replying){
+                struct partition_mark mark = {.out = 0, .err = 0, .held = 0};
+                partitions.replying = 0;
+                partition_answer(&mark, NULL, 0);
+        }
+        if (partitions.pending){
+                partitions.pending = 0;
+                for (int i = 0; i < partitions.count; i++){
+                        partition_relay(i, PARTITION_DISCARD, NULL);
+                }
+        }
+}
+
+// things related to replication
+int replication_start(enum replication_role role, char * path){
+        struct sockaddr_un address;
+        if (strlen(path) >= sizeof(address.sun_path)){
+                fprintf(stderr, "!!! %s: socket path too long\n", path);
+                return -1;
+        }
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        strcpy(address.sun_path, path);
+
+        replication.role = role;
+        replication.path = path;
+        // a peer that goes away shows up as a failed write rather than a signal
+        signal(SIGPIPE, SIG_IGN);
+        pthread_t thread;
+
+        if (role == REPLICATION_PRIMARY){
+                snprintf(replication.epoch, sizeof(replication.epoch), "%ld.%ld", (long)getpid(), (long)time(NULL));
+
+                // a socket left behind by an earlier primary is replaced, anything else is left alone
+                struct stat existing;
+                if (stat(path, &existing) == 0 && S_ISSOCK(existing.st_mode)){
+                        unlink(path);
+                }
+                replication.listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+                if (replication.listen_fd < 0 || bind(replication.listen_fd, (struct sockaddr *)&address, sizeof(address)) != 0
+                                || listen(replication.listen_fd, 16) != 0){
+                        perror("Failed to listen for replicas");
+                        return -1;
+                }
+                if (pthread_create(&thread, NULL, replication_accept, NULL) != 0){
+                        perror("Failed to start replication");
+                        return -1;
+                }
+                pthread_detach(thread);
+                return 0;
+        }
+
+        if (pthread_create(&thread, NULL, replication_receive, NULL) != 0){
+                perror("Failed to start replication");
+                return -1;
+        }
+        pthread_detach(thread);
+
+        // giving the first snapshot a chance to arrive before any question is asked
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += REPLICA_MAX_LAG;
+        pthread_mutex_lock(&replication.lock);
+        while (!replication.ready && pthread_cond_timedwait(&replication.changed, &replication.lock, &deadline) == 0){
+        }
+        pthread_mutex_unlock(&replication.lock);
+        return 0;
+}
+
+void replication_stop(){
+        if (replication.role == REPLICATION_NONE){
+                return;
+        }
+        // the other threads are left waiting for the lock until the process exits
+        if (!replication.held){
+                pthread_mutex_lock(&replication.lock);
+                replication.held = 1;
+        }
+        if (replication.role == REPLICATION_PRIMARY){
+                close(replication.listen_fd);
+                unlink(replication.path);
+                if (replication.journal != NULL){
+                        for (int i = 0; i < JOURNAL_SIZE; i++){
+                                mem_free(MEM_JOURNAL, replication.journal[i].recipe, replication.journal[i].recipe_size);
+                        }
+                        mem_free(MEM_JOURNAL, replication.journal, JOURNAL_SIZE * sizeof(struct journal_entry));
+                        replication.journal = NULL;
+                }
+        }
+        replication.role = REPLICATION_NONE;
+}
+
+void replication_hold(){
+        if (replication.role == REPLICATION_NONE){
+                return;
+        }
+        pthread_mutex_lock(&replication.lock);
+        replication.held = 1;
+}
+
+void replication_release(){
+        if (replication.role == REPLICATION_NONE || !replication.held){
+                return;
+        }
+        // waking the shipping threads if the request journaled anything
+        if (replication.last_seq != replication.signaled_seq){
+                replication.signaled_seq = replication.last_seq;
+                pthread_cond_broadcast(&replication.changed);
+        }
+        replication.held = 0;
+        pthread_mutex_unlock(&replication.lock);
+}
+
+void journal_append(enum journal_kind kind, char * id, long long value, items_needed_t * items){
+        // making room for the journal the first time around
+        if (replication.journal == NULL){
+                replication.journal = mem_calloc(MEM_JOURNAL, JOURNAL_SIZE, sizeof(struct journal_entry));
+        }
+        long seq = ++replication.last_seq;
+        if (replication.journal == NULL){
+                // replicas that need this entry get a snapshot instead
+                replication.first_seq = seq + 1;
+                return;
+        }
+
+        struct journal_entry * entry = &replication.journal[seq & (JOURNAL_SIZE - 1)];
+        mem_free(MEM_JOURNAL, entry->recipe, entry->recipe_size);
+        entry->kind = kind;
+        strcpy(entry->id, id);
+        entry->value = value;
+        entry->recipe = NULL;
+        entry->recipe_size = 0;
+        if (seq - replication.first_seq >= JOURNAL_SIZE){
+                replication.first_seq = seq - JOURNAL_SIZE + 1;
+        }
+
+        if (items != NULL){
+                struct record recipe = {.data = NULL, .length = 0, .capacity = 0, .failed = 0};
+                journal_recipe(&recipe, items);
+                entry->recipe = recipe.failed ? NULL : mem_alloc(MEM_JOURNAL, recipe.length + 1);
+                if (entry->recipe == NULL){
+                        replication.first_seq = seq + 1;
+                }
+                else{
+                        memcpy(entry->recipe, recipe.data, recipe.length);
+                        entry->recipe[recipe.length] = '\0';
+                        entry->recipe_size = recipe.length + 1;
+                }
+                record_free(&recipe);
+        }
+}
+
+void journal_recipe(struct record * record, items_needed_t * items){
+        char quantity[32];
+        for (item_t * item = items->item_list; item != NULL; item = item->next){
+                record_bytes(record, " ", 1);
+                record_bytes(record, item->id, strlen(item->id));
+                int length = snprintf(quantity, sizeof(quantity), " %lld", item->quantity);
+                record_bytes(record, quantity, length);
+        }
+}
+
+void journal_write(struct record * record, struct journal_entry * entry){
+        char line[ID_MAX + 64];
+        int length;
+        if (entry->kind == JOURNAL_PART){
+                length = snprintf(line, sizeof(line), "part %s\n", entry->id);
+        }
+        else if (entry->kind == JOURNAL_ASSEMBLY){
+                length = snprintf(line, sizeof(line), "assembly %s %lld", entry->id, entry->value);
+                record_bytes(record, line, length);
+                record_bytes(record, entry->recipe, entry->recipe_size - 1);
+                length = snprintf(line, sizeof(line), "\n");
+        }
+        else if (entry->kind == JOURNAL_ON_HAND){
+                length = snprintf(line, sizeof(line), "onhand %s %lld\n", entry->id, entry->value);
+        }
+        else{
+                length = snprintf(line, sizeof(line), "clear\n");
+        }
+        record_bytes(record, line, length);
+}
+
+// the whole inventory as entries, in the order it was built
+void journal_snapshot(struct record * record){
+        char line[ID_MAX + 64];
+        int length;
+        for (part_t * part = inv.part_list; part != NULL; part = part->next){
+                length = snprintf(line, sizeof(line), "part %s\n", part->id);
+                record_bytes(record, line, length);
+        }
+        for (assembly_t * assembly = inv.assembly_list; assembly != NULL; assembly = assembly->next){
+                length = snprintf(line, sizeof(line), "assembly %s %lld", assembly->id, assembly->capacity);
+                record_bytes(record, line, length);
+                journal_recipe(record, assembly->items);
+                record_bytes(record, "\n", 1);
+        }
+        for (assembly_t * assembly = inv.assembly_list; assembly != NULL; assembly = assembly->next){
+                if (assembly->on_hand != 0){
+                        length = snprintf(line, sizeof(line), "onhand %s %lld\n", assembly->id, assembly->on_hand);
+                        record_bytes(record, line, length);
+                }
+        }
+}
+
+void * replication_accept(void * arg){
+        (void)arg;
+        while (1){
+                int fd = accept(replication.listen_fd, NULL, NULL);
+                if (fd < 0){
+                        if (errno == EINTR){
+                                continue;
+                        }
+                        // the socket was closed
+                        return NULL;
+                }
+                pthread_t thread;
+                if (pthread_create(&thread, NULL, replication_ship, (void *)(intptr_t)fd) != 0){
+                        close(fd);
+                        continue;
+                }
+                pthread_detach(thread);
+        }
+}
+
+// one replica's connection: a snapshot or the tail it asked for, then the journal as it grows
+void * replication_ship(void * arg){
+        int fd = (int)(intptr_t)arg;
+
+        // reading "resume EPOCH SEQ"
+        char request[128];
+        size_t length = 0;
+        while (length == 0 || request[length - 1] != '\n'){
+                if (length == sizeof(request) - 1){
+                        break;
+                }
+                ssize_t got = read(fd, request + length, sizeof(request) - 1 - length);
+                if (got <= 0){
+                        close(fd);
+                        return NULL;
+                }
+                length += got;
+        }
+        request[length] = '\0';
+        char epoch[32];
+        long seq;
+        if (sscanf(request, "resume %31s %ld", epoch, &seq) != 2){
+                epoch[0] = '\0';
+                seq = -1;
+        }
+
+        struct record batch = {.data = NULL, .length = 0, .capacity = 0, .failed = 0};
+        char line[64];
+        long next = 0; // the next entry to ship; 0 until the replica has a snapshot or has resumed
+        pthread_mutex_lock(&replication.lock);
+        if (strcmp(epoch, replication.epoch) == 0 && seq >= replication.first_seq - 1 && seq <= replication.last_seq){
+                next = seq + 1;
+                length = snprintf(line, sizeof(line), "resume %ld\n", seq);
+                record_bytes(&batch, line, length);
+        }
+        while (1){
+                // a new replica, or one the journal has moved past, starts over from a snapshot
+                if (next < replication.first_seq){
+                        length = snprintf(line, sizeof(line), "snapshot %s %ld\n", replication.epoch, replication.last_seq);
+                        record_bytes(&batch, line, length);
+                        journal_snapshot(&batch);
+                        record_bytes(&batch, "end\n", 4);
+                        next = replication.last_seq + 1;
+                }
+                for (int count = 0; next <= replication.last_seq && count < JOURNAL_BATCH; count++, next++){
+                        journal_write(&batch, &replication.journal[next & (JOURNAL_SIZE - 1)]);
+                }
+                if (batch.length == 0){
+                        length = snprintf(line, sizeof(line), "tick %ld\n", next - 1);
+                        record_bytes(&batch, line, length);
+                }
+                pthread_mutex_unlock(&replication.lock);
+
+                if (batch.failed || replication_send(fd, &batch) != 0){
+                        break;
+                }
+                batch.length = 0;
+
+                // sleeping until the main thread journals something, or it is time for a tick
+                pthread_mutex_lock(&replication.lock);
+                if (next > replication.last_seq){
+                        struct timespec deadline;
+                        clock_gettime(CLOCK_REALTIME, &deadline);
+                        deadline.tv_sec += REPLICA_TICK;
+                        while (next > replication.last_seq && pthread_cond_timedwait(&replication.changed, &replication.lock, &deadline) == 0){
+                        }
+                }
+        }
+        close(fd);
+        record_free(&batch);
+        return NULL;
+}
+
+int replication_send(int fd, struct record * record){
+        size_t sent = 0;
+        while (sent < record->length){
+                ssize_t wrote = write(fd, record->data + sent, record->length - sent);
+                if (wrote < 0 && errno == EINTR){
+                        continue;
+                }
+                if (wrote <= 0){
+                        return -1;
+                }
+                sent += wrote;
+        }
+        return 0;
+}
+
+// a replica's connection to its primary, reconnecting whenever it is lost
+void * replication_receive(void * arg){
+        (void)arg;
+        struct sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        strcpy(address.sun_path, replication.path);
+
+        struct record buffer = {.data = NULL, .length = 0, .capacity = 0, .failed = 0};
+        while (1){
+                int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+                if (fd < 0 || connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0){
+                        if (fd >= 0){
+                                close(fd);
+                        }
+                        sleep(REPLICA_TICK);
+                        continue;
+                }
+
+                char request[80];
+                pthread_mutex_lock(&replication.lock);
+                int length = snprintf(request, sizeof(request), "resume %s %ld\n", replication.epoch[0] != '\0' ? replication.epoch : "-", replication.applied_seq);
+                pthread_mutex_unlock(&replication.lock);
+                struct record resume = {.data = request, .length = length, .capacity = 0, .failed = 0};
+
+                if (replication_send(fd, &resume) != 0){
+                        close(fd);
+                        sleep(REPLICA_TICK);
+                        continue;
+                }
+
+                long snapshot_seq = -1; // while a snapshot is coming in, the entry it brings the replica up to
+                buffer.length = 0;
+                buffer.failed = 0;
+                while (record_reserve(&buffer, 65536) == 0){
+                        ssize_t got = read(fd, buffer.data + buffer.length, 65536);
+                        if (got < 0 && errno == EINTR){
+                                continue;
+                        }
+                        if (got <= 0){
+                                break;
+                        }
+                        buffer.length += got;
+
+                        // applying every complete line under one hold of the lock
+                        pthread_mutex_lock(&replication.lock);
+                        clock_gettime(CLOCK_MONOTONIC, &replication.last_contact);
+                        char * start = buffer.data;
+                        char * end = buffer.data + buffer.length;
+                        char * newline;
+                        while ((newline = memchr(start, '\n', end - start)) != NULL){
+                                *newline = '\0';
+                                replica_apply(start, &snapshot_seq);
+                                start = newline + 1;
+                        }
+                        feed_flush();
+                        pthread_cond_broadcast(&replication.changed);
+                        pthread_mutex_unlock(&replication.lock);
+
+                        buffer.length = end - start;
+                        memmove(buffer.data, start, buffer.length);
+                }
+                close(fd);
+                sleep(REPLICA_TICK);
+        }
+        return NULL;
+}
+
+// one line from the primary, with the lock held
+void replica_apply(char * line, long * snapshot_seq){
+        char * save;
+        char * kind = strtok_r(line, " ", &save);
+        if (kind == NULL){
+                return;
+        }
+        if (strcmp(kind, "snapshot") == 0){
+                char * epoch = strtok_r(NULL, " ", &save);
+                char * seq = strtok_r(NULL, " ", &save);
+                if (epoch == NULL || seq == NULL){
+                        return;
+                }
+                // a snapshot cut off halfway leaves nothing to resume from
+                snprintf(replication.epoch, sizeof(replication.epoch), "%s", epoch);
+                replication.applied_seq = -1;
+                replication.ready = 0;
+                *snapshot_seq = atol(seq);
+                clear();
+                return;
+        }
+        if (strcmp(kind, "end") == 0){
+                replication.applied_seq = *snapshot_seq;
+                replication.ready = 1;
+                *snapshot_seq = -1;
+                return;
+        }
+        if (strcmp(kind, "resume") == 0 || strcmp(kind, "tick") == 0){
+                return;
+        }
+
+        if (strcmp(kind, "part") == 0){
+                char * id = strtok_r(NULL, " ", &save);
+                add_part(&inv, id);
+        }
+        else if (strcmp(kind, "assembly") == 0){
+                char * id = strtok_r(NULL, " ", &save);
+                char * capacity = strtok_r(NULL, " ", &save);
+                items_needed_t * items = mem_calloc(MEM_ITEMS_NEEDED, 1, sizeof(items_needed_t));
+                if (items == NULL){
+                        report_error("Memory allocation failed");
+                }
+                else{
+                        char * item;
+                        char * quantity;
+                        while ((item = strtok_r(NULL, " ", &save)) != NULL && (quantity = strtok_r(NULL, " ", &save)) != NULL){
+                                add_item(items, item, atoll(quantity));
+                        }
+                        add_assembly(&inv, id, atoll(capacity), items);
+                }
+        }
+        else if (strcmp(kind, "onhand") == 0){
+                char * id = strtok_r(NULL, " ", &save);
+                char * on_hand = strtok_r(NULL, " ", &save);
+                assembly_t * assembly = find_assembly(&inv, id);
+                if (assembly != NULL){
+                        set_on_hand(assembly, atoll(on_hand));
+                }
+        }
+        else if (strcmp(kind, "clear") == 0){
+                clear();
+        }
+
+        // the entries of a snapshot are not journal entries
+        if (*snapshot_seq < 0){
+                replication.applied_seq++;
+        }
+}
+
+// a replica answers questions only, and only while it is close enough behind its primary
+int replica_refuses(char * line){
+        if (replication.role != REPLICATION_REPLICA){
+                return 0;
+        }
+        char request[64];
+        if (sscanf(line, " %63s", request) != 1){
+                return 0;
+        }
+        const char * changes[] = {"addPart", "addAssembly", "fulfillOrder", "stock", "restock", "empty", "importParts",
+                                  "importAssemblies", "reserve", "commit", "release", "budget", "clear", "reloadCatalog"};
+        for (size_t i = 0; i < sizeof(changes) / sizeof(changes[0]); i++){
+                if (strcmp(request, changes[i]) == 0){
+                        report_error("%s: not available on a read-only replica", request);
+                        return 1;
+                }
+        }
+        if (strcmp(request, "inventory") == 0 || strcmp(request, "parts") == 0 || strcmp(request, "simulate") == 0){
+                if (!replication.ready){
+                        report_error("%s: the replica has no snapshot from the primary yet", request);
+                        return 1;
+                }
+                struct timespec now;
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                long lag = now.tv_sec - replication.last_contact.tv_sec;
+                if (lag > REPLICA_MAX_LAG){
+                        report_error("%s: the replica has not heard from the primary for %ld seconds", request, lag);
+                        return 1;
+                }
+        }
+        return 0;
+}
+
+// things related to request input
+void input_open(struct input * input, FILE * fp, int direct){
+        input->fp = fp;
+        input->fd = fileno(fp);
+        input->direct = direct;
+        input->buffers[0] = NULL;
+        input->buffers[1] = NULL;
+        input->lengths[0] = 0;
+        input->lengths[1] = 0;
+        input->full[0] = 0;
+        input->full[1] = 0;
+        input->current = 0;
+        input->holding = 0;
+        input->position = 0;
+        input->done = 0;
+        input->codec = CODEC_UNKNOWN;
+        input->raw = NULL;
+        input->raw_start = 0;
+        input->raw_length = 0;
+        input->raw_ended = 0;
+        input->stream = NULL;
+        input->partial = 0;
+        input->ended = 0;
+        if (direct){
+                return;
+        }
+
+        pthread_mutex_init(&input->lock, NULL);
+        pthread_cond_init(&input->changed, NULL);
+        input->buffers[0] = mem_alloc(MEM_INPUT, INPUT_CHUNK);
+        input->buffers[1] = mem_alloc(MEM_INPUT, INPUT_CHUNK);
+        if (input->buffers[0] == NULL || input->buffers[1] == NULL
+                        || pthread_create(&input->thread, NULL, input_read_ahead, input) != 0){
+                // reading on the main thread still works, just without the overlap
+                mem_free(MEM_INPUT, input->buffers[0], INPUT_CHUNK);
+                mem_free(MEM_INPUT, input->buffers[1], INPUT_CHUNK);
+                input->buffers[0] = NULL;
+                input->buffers[1] = NULL;
+                input->direct = 1;
+        }
+}
+
+// fgets() on the input: at most size - 1 bytes, up to and including a newline
+char * input_gets(struct input * input, char * line, int size){
+        if (input->direct){
+                return fgets(line, size, input->fp);
+        }
+
+        int length = 0;
+        while (length < size - 1){
+                // waiting for the reader thread to fill the next buffer
+                if (!input->holding){
+                        pthread_mutex_lock(&input->lock);
+                        while (!input->full[input->current]){
+                                pthread_cond_wait(&input->changed, &input->lock);
+                        }
+                        pthread_mutex_unlock(&input->lock);
+                        if (input->lengths[input->current] == 0){
+                                break;
+                        }
+                        input->holding = 1;
+                        input->position = 0;
+                }
+
+                char * start = input->buffers[input->current] + input->position;
+                size_t available = input->lengths[input->current] - input->position;
+                if (available > (size_t)(size - 1 - length)){
+                        available = size - 1 - length;
+                }
+                char * newline = memchr(start, '\n', available);
+                size_t count = newline != NULL ? (size_t)(newline - start) + 1 : available;
+                memcpy(line + length, start, count);
+                length += count;
+                input->position += count;
+
+                // handing a used up buffer back to the reader thread
+                if (input->position == input->lengths[input->current]){
+                        pthread_mutex_lock(&input->lock);
+                        input->full[input->current] = 0;
+                        pthread_cond_broadcast(&input->changed);
+                        pthread_mutex_unlock(&input->lock);
+                        input->holding = 0;
+                        input->current ^= 1;
+                }
+                if (newline != NULL){
+                        break;
+                }
+        }
+        if (length == 0){
+                return NULL;
+        }
+        line[length] = '\0';
+        return line;
+}
+
+void input_close(struct input * input){
+        if (!input->direct){
+                // a reader thread still waiting on a pipe is left to the exit that follows
+                pthread_mutex_lock(&input->lock);
+                int done = input->done;
+                pthread_mutex_unlock(&input->lock);
+                if (!done){
+                        return;
+                }
+                pthread_join(input->thread, NULL);
+                mem_free(MEM_INPUT, input->buffers[0], INPUT_CHUNK);
+                mem_free(MEM_INPUT, input->buffers[1], INPUT_CHUNK);
+                mem_free(MEM_INPUT, input->raw, INPUT_CHUNK);
+#ifdef INPUT_GZIP
+                if (input->codec == CODEC_GZIP && input->stream != NULL){
+                        inflateEnd(input->stream);
+                        mem_free(MEM_INPUT, input->stream, sizeof(z_stream));
+                }
+#endif
+#ifdef INPUT_ZSTD
+                if (input->codec == CODEC_ZSTD){
+                        ZSTD_freeDStream(input->stream);
+                }
+#endif
+        }
+        fclose(input->fp);
+}
+
+void * input_read_ahead(void * arg){
+        struct input * input = arg;
+        for (int i = 0; ; i ^= 1){
+                pthread_mutex_lock(&input->lock);
+                while (input->full[i]){
+                        pthread_cond_wait(&input->changed, &input->lock);
+                }
+                pthread_mutex_unlock(&input->lock);
+
+                size_t length = input_fill(input, input->buffers[i]);
+
+                pthread_mutex_lock(&input->lock);
+                input->lengths[i] = length;
+                input->full[i] = 1;
+                input->done = length == 0;
+                pthread_cond_broadcast(&input->changed);
+                pthread_mutex_unlock(&input->lock);
+                if (length == 0){
+                        return NULL;
+                }
+        }
+}
+
+// up to INPUT_CHUNK bytes of requests, 0 at the end; on the reader thread
+size_t input_fill(struct input * input, char * out){
+        static const unsigned char gzip_magic[] = {0x1f, 0x8b};
+        static const unsigned char zstd_magic[] = {0x28, 0xb5, 0x2f, 0xfd};
+        if (input->ended){
+                return 0;
+        }
+
+        // the first bytes say whether the requests are compressed; a short read that could be the start of a magic
+        // number is only trusted once more bytes have come or the file has ended
+        if (input->codec == CODEC_UNKNOWN){
+                input->raw = mem_alloc(MEM_INPUT, INPUT_CHUNK);
+                if (input->raw == NULL){
+                        fprintf(stderr, "!!! Memory allocation failed\n");
+                        input->ended = 1;
+                        return 0;
+                }
+                while (input->raw_length < sizeof(zstd_magic) && !input->raw_ended && (input->raw_length == 0
+                                || input_magic(input, gzip_magic, sizeof(gzip_magic)) || input_magic(input, zstd_magic, sizeof(zstd_magic)))){
+                        input_raw(input);
+                }
+                input->codec = CODEC_PLAIN;
+                if (input->raw_length >= sizeof(gzip_magic) && input_magic(input, gzip_magic, sizeof(gzip_magic))){
+                        input->codec = CODEC_GZIP;
+                }
+                else if (input->raw_length >= sizeof(zstd_magic) && input_magic(input, zstd_magic, sizeof(zstd_magic))){
+                        input->codec = CODEC_ZSTD;
+                }
+        }
+
+        if (input->codec == CODEC_PLAIN){
+                // what was read to look for a magic number comes first
+                if (input->raw != NULL){
+                        size_t length = input->raw_length;
+                        memcpy(out, input->raw, length);
+                        mem_free(MEM_INPUT, input->raw, INPUT_CHUNK);
+                        input->raw = NULL;
+                        if (length > 0 || input->raw_ended){
+                                input->ended = length == 0;
+                                return length;
+                        }
+                }
+                ssize_t got;
+                do {
+                        got = read(input->fd, out, INPUT_CHUNK);
+                } while (got < 0 && errno == EINTR);
+                if (got < 0){
+                        perror("Failed to read requests");
+                }
+                if (got <= 0){
+                        input->ended = 1;
+                        return 0;
+                }
+                return got;
+        }
+        return input_decode(input, out);
+}
+
+// whether the bytes read so far agree with a magic number, as far as both go
+int input_magic(struct input * input, const unsigned char * magic, size_t size){
+        size_t length = input->raw_length < size ? input->raw_length : size;
+        return memcmp(input->raw, magic, length) == 0;
+}
+
+// reads more of the request file after the bytes not yet decoded
+void input_raw(struct input * input){
+        input->raw_length -= input->raw_start;
+        memmove(input->raw, input->raw + input->raw_start, input->raw_length);
+        input->raw_start = 0;
+
+        ssize_t got;
+        do {
+                got = read(input->fd, input->raw + input->raw_length, INPUT_CHUNK - input->raw_length);
+        } while (got < 0 && errno == EINTR);
+        if (got < 0){
+                perror("Failed to read requests");
+        }
+        if (got <= 0){
+                input->raw_ended = 1;
+                return;
+        }
+        input->raw_length += got;
+}
+
+// decompresses up to INPUT_CHUNK bytes, and no more once some requests are ready and the rest would mean waiting to read
+size_t input_decode(struct input * input, char * out){
+#ifdef INPUT_GZIP
+        if (input->codec == CODEC_GZIP){
+                z_stream * stream = input->stream;
+                if (stream == NULL){
+                        stream = mem_calloc(MEM_INPUT, 1, sizeof(z_stream));
+                        // 15 + 32: the largest window, with the gzip header detected and checked
+                        if (stream == NULL || inflateInit2(stream, 15 + 32) != Z_OK){
+                                fprintf(stderr, "!!! Memory allocation failed\n");
+                                mem_free(MEM_INPUT, stream, sizeof(z_stream));
+                                input->ended = 1;
+                                return 0;
+                        }
+                        input->stream = stream;
+                }
+                stream->next_out = (Bytef *)out;
+                stream->avail_out = INPUT_CHUNK;
+                while (stream->avail_out > 0){
+                        stream->next_in = (Bytef *)input->raw + input->raw_start;
+                        stream->avail_in = input->raw_length - input->raw_start;
+                        int status = inflate(stream, Z_NO_FLUSH);
+                        input->raw_start = input->raw_length - stream->avail_in;
+                        if (status == Z_STREAM_END){
+                                // concatenated members, as appending to a .gz file makes
+                                inflateReset(stream);
+                        }
+                        else if (status == Z_BUF_ERROR){
+                                if (input->raw_ended && stream->total_in > 0){
+                                        fprintf(stderr, "!!! truncated gzip request file\n");
+                                        input->ended = 1;
+                                }
+                                if (stream->avail_out < INPUT_CHUNK || input->raw_ended){
+                                        break;
+                                }
+                                input_raw(input);
+                        }
+                        else if (status != Z_OK){
+                                fprintf(stderr, "!!! corrupt gzip request file\n");
+                                input->ended = 1;
+                                break;
+                        }
+                }
+                return INPUT_CHUNK - stream->avail_out;
+        }
+#endif
+#ifdef INPUT_ZSTD
+        if (input->codec == CODEC_ZSTD){
+                if (input->stream == NULL){
+                        input->stream = ZSTD_createDStream();
+                        if (input->stream == NULL || ZSTD_isError(ZSTD_initDStream(input->stream))){
+                                fprintf(stderr, "!!! Memory allocation failed\n");
+                                input->ended = 1;
+                                return 0;
+                        }
+                }
+                ZSTD_outBuffer output = {out, INPUT_CHUNK, 0};
+                while (output.pos < output.size){
+                        ZSTD_inBuffer compressed = {input->raw + input->raw_start, input->raw_length - input->raw_start, 0};
+                        size_t before = output.pos;
+                        size_t status = ZSTD_decompressStream(input->stream, &output, &compressed);
+                        input->raw_start += compressed.pos;
+                        if (compressed.pos > 0 || output.pos > before){
+                                input->partial = status != 0;
+                        }
+                        if (ZSTD_isError(status)){
+                                fprintf(stderr, "!!! corrupt zstd request file: %s\n", ZSTD_getErrorName(status));
+                                input->ended = 1;
+                                break;
+                        }
+                        // nothing decoded from nothing read: more is needed
+                        if (output.pos == before && compressed.pos == 0){
+                                if (input->raw_ended && input->partial){
+                                        fprintf(stderr, "!!! truncated zstd request file\n");
+                                        input->ended = 1;
+                                }
+                                if (output.pos > 0 || input->raw_ended){
+                                        break;
+                                }
+                                input_raw(input);
+                        }
+                }
+                return output.pos;
+        }
+#endif
+        (void)out;
+        fprintf(stderr, "!!! compressed request file: build with %s to read it\n",
+                input->codec == CODEC_GZIP ? "-DINPUT_GZIP and -lz" : "-DINPUT_ZSTD and -lzstd");
+        input->ended = 1;
+        return 0;
+}
+
+// things related to capture and replay
+int capture_start(char * filename){
+        capture.fp = fopen(filename, "w");
+        if (capture.fp == NULL){
+                perror("Failed to open capture file");
+                return -1;
+        }
+        // written out in blocks rather than a line per request
+        setvbuf(capture.fp, NULL, _IOFBF, 1 << 16);
+        clock_gettime(CLOCK_MONOTONIC, &capture.start);
+        return 0;
+}
+
+void capture_request(char * request){
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long long stamp = (now.tv_sec - capture.start.tv_sec) * 1000000LL + (now.tv_nsec - capture.start.tv_nsec) / 1000;
+        fprintf(capture.fp, "%lld\t%s\n", stamp, request);
+}
+
+void capture_stop(){
+        if (capture.fp != NULL){
+                fclose(capture.fp);
+                capture.fp = NULL;
+        }
+}
+
+// puts a pipe in place of standard output and standard error, each read by a replay_tee() thread
+int replay_start(){
+        fflush(stdout);
+        fflush(stderr);
+        for (int i = 0; i < 2; i++){
+                struct replay_stream * stream = &replay.streams[i];
+                int target = i == 0 ? STDOUT_FILENO : STDERR_FILENO;
+                int fds[2];
+                stream->checksum = 14695981039346656037ULL; // the FNV-1a offset basis
+                stream->out = dup(target);
+                if (stream->out < 0 || pipe(fds) != 0){
+                        perror("Failed to start replay");
+                        return -1;
+                }
+                stream->fd = fds[0];
+                if (pthread_create(&stream->thread, NULL, replay_tee, stream) != 0){
+                        fprintf(stderr, "!!! Failed to start replay\n");
+                        return -1;
+                }
+                stream->started = 1;
+                dup2(fds[1], target);
+                close(fds[1]);
+        }
+        return 0;
+}
+
+// strips the time off a captured line and, when paced, waits until it is due; NULL if the line wasn't captured
+char * replay_next(char * line){
+        char * end;
+        long long stamp = strtoll(line, &end, 10);
+        if (end == line || *end != '\t'){
+                report_error("%s: not a captured request", trim(line));
+                return NULL;
+        }
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (replay.first_stamp < 0){
+                replay.first_stamp = stamp;
+                replay.start = now;
+        }
+        replay.issued = now;
+        if (replay.paced && stamp > replay.first_stamp){
+                long long offset = (stamp - replay.first_stamp) * 1000;
+                struct timespec due = replay.start;
+                due.tv_sec += offset / 1000000000;
+                due.tv_nsec += offset % 1000000000;
+                if (due.tv_nsec >= 1000000000){
+                        due.tv_sec++;
+                        due.tv_nsec -= 1000000000;
+                }
+                while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR){
+                }
+                replay.issued = due;
+        }
+        replay.in_flight = 1;
+        return end + 1;
+}
+
+// the latency of the request replay_next() last handed out, once it has been served
+void replay_finish(){
+        if (!replay.in_flight){
+                return;
+        }
+        replay.in_flight = 0;
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        if (grow_array(MEM_SCRATCH, (void **)&replay.latencies, &replay.capacity, replay.count + 1, sizeof(long long), 1 << 12) != 0){
+                return;
+        }
+        replay.latencies[replay.count++] = (now.tv_sec - replay.issued.tv_sec) * 1000000000LL + (now.tv_nsec - replay.issued.tv_nsec);
+}
+
+// on a thread of its own: adds one output to its checksum and passes it on, until the pipe is closed
+void * replay_tee(void * arg){
+        struct replay_stream * stream = arg;
+        char buffer[1 << 16];
+        while (1){
+                ssize_t got = read(stream->fd, buffer, sizeof(buffer));
+                if (got < 0 && errno == EINTR){
+                        continue;
+                }
+                if (got <= 0){
+                        return NULL;
+                }
+                for (ssize_t i = 0; i < got; i++){
+                        stream->checksum = (stream->checksum ^ (unsigned char)buffer[i]) * 1099511628211ULL;
+                }
+                for (ssize_t written = 0; written < got; ){
+                        ssize_t put = write(stream->out, buffer + written, got - written);
+                        if (put < 0 && errno != EINTR){
+                                break;
+                        }
+                        written += put > 0 ? put : 0;
+                }
+        }
+}
+
+void replay_stop(){
+        if (!replay.active){
+                return;
+        }
+        replay.active = 0;
+        replay_finish();
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double seconds = replay.first_stamp < 0 ? 0 : (now.tv_sec - replay.start.tv_sec) + (now.tv_nsec - replay.start.tv_nsec) / 1e9;
+
+        // putting the outputs back closes the pipes, once the threads have passed on what is left in them
+        fflush(stdout);
+        fflush(stderr);
+        for (int i = 0; i < 2; i++){
+                struct replay_stream * stream = &replay.streams[i];
+                if (stream->started){
+                        dup2(stream->out, i == 0 ? STDOUT_FILENO : STDERR_FILENO);
+                        pthread_join(stream->thread, NULL);
+                        close(stream->fd);
+                        close(stream->out);
+                }
+        }
+
+        fprintf(stderr, "replay: %zu requests in %.3f s, %.0f requests/s\n", replay.count, seconds, seconds > 0 ? replay.count / seconds : 0.0);
+        if (replay.count > 0){
+                qsort(replay.latencies, replay.count, sizeof(long long), latency_compare);
+                // nearest rank, in parts per ten thousand
+                int ranks[] = {5000, 9000, 9900, 9990, 10000};
+                double micros[5];
+                for (int i = 0; i < 5; i++){
+                        size_t rank = (replay.count * ranks[i] + 9999) / 10000;
+                        micros[i] = replay.latencies[rank - 1] / 1e3;
+                }
+                fprintf(stderr, "replay: latency p50 %.1f us, p90 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n",
+                        micros[0], micros[1], micros[2], micros[3], micros[4]);
+        }
+        fprintf(stderr, "replay: checksum %016llx output, %016llx errors\n", replay.streams[0].checksum, replay.streams[1].checksum);
+        mem_free(MEM_SCRATCH, replay.latencies, replay.capacity * sizeof(long long));
+        replay.latencies = NULL;
+        replay.capacity = 0;
+}
+
+int latency_compare(const void * a, const void * b){
+        long long l1 = *(const long long *)a;
+        long long l2 = *(const long long *)b;
+        return (l1 > l2) - (l1 < l2);
+}
+
+// things related to tracing
+void trace_start(char * filename){
+        if (tracing){
+                report_error("%s: already tracing to %s", filename, tracer.filename);
+                return;
+        }
+        if (!tracer.key_ready){
+                if (pthread_key_create(&tracer.key, trace_release) != 0){
+                        report_error("Memory allocation failed");
+                        return;
+                }
+                tracer.key_ready = 1;
+        }
+        char * name = mem_alloc(MEM_TRACE, strlen(filename) + 1);
+        if (name == NULL){
+                report_error("Memory allocation failed");
+                return;
+        }
+        FILE * fp = fopen(filename, "w");
+        if (fp == NULL){
+                report_error("%s: cannot open file", filename);
+                mem_free(MEM_TRACE, name, strlen(filename) + 1);
+                return;
+        }
+        strcpy(name, filename);
+        tracer.fp = fp;
+        tracer.filename = name;
+        tracer.buffers = NULL;
+        tracer.thread_count = 0;
+        tracer.lost = 0;
+        clock_gettime(CLOCK_MONOTONIC, &tracer.start);
+        tracing = 1;
+}
+
+void trace_stop(){
+        if (!tracing){
+                return;
+        }
+        tracing = 0;
+        trace_export(tracer.fp);
+        fclose(tracer.fp);
+
+        // worker threads have exited by now, so only the main thread still points at a buffer
+        pthread_setspecific(tracer.key, NULL);
+        struct trace_buffer * buffer = tracer.buffers;
+        while (buffer != NULL){
+                struct trace_buffer * temp = buffer;
+                buffer = buffer->next;
+                mem_free(MEM_TRACE, temp->events, TRACE_RING_SIZE * sizeof(struct trace_event));
+                mem_free(MEM_TRACE, temp, sizeof(struct trace_buffer));
+        }
+        tracer.buffers = NULL;
+        mem_free(MEM_TRACE, tracer.filename, strlen(tracer.filename) + 1);
+        tracer.filename = NULL;
+        tracer.fp = NULL;
+}
+
+// the calling thread's buffer, on its first event either one left behind by an exited thread or a new one
+struct trace_buffer * trace_buffer(){
+        struct trace_buffer * buffer = pthread_getspecific(tracer.key);
+        if (buffer != NULL){
+                return buffer;
+        }
+
+        // every parallel make() starts new workers, so their buffers are passed on rather than piling up
+        pthread_mutex_lock(&tracer.lock);
+        buffer = tracer.buffers;
+        while (buffer != NULL && !buffer->idle){
+                buffer = buffer->next;
+        }
+        if (buffer != NULL){
+                buffer->idle = 0;
+        }
+        pthread_mutex_unlock(&tracer.lock);
+        if (buffer != NULL){
+                pthread_setspecific(tracer.key, buffer);
+                return buffer;
+        }
+
+        buffer = mem_alloc(MEM_TRACE, sizeof(struct trace_buffer));
+        struct trace_event * events = mem_alloc(MEM_TRACE, TRACE_RING_SIZE * sizeof(struct trace_event));
+        if (buffer == NULL || events == NULL){
+                mem_free(MEM_TRACE, buffer, sizeof(struct trace_buffer));
+                mem_free(MEM_TRACE, events, TRACE_RING_SIZE * sizeof(struct trace_event));
+                return NULL;
+        }
+        buffer->events = events;
+        buffer->written = 0;
+        buffer->depth = 0;
+        buffer->idle = 0;
+        pthread_mutex_lock(&tracer.lock);
+        buffer->thread = tracer.thread_count++;
+        buffer->next = tracer.buffers;
+        tracer.buffers = buffer;
+        pthread_mutex_unlock(&tracer.lock);
+        pthread_setspecific(tracer.key, buffer);
+        return buffer;
+}
+
+void trace_event(char phase, enum trace_kind kind, assembly_t * assembly, long long requested, long long netted){
+        struct trace_buffer * buffer = trace_buffer();
+        if (buffer == NULL){
+                __atomic_add_fetch(&tracer.lost, 1, __ATOMIC_RELAXED);
+                return;
+        }
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        if (phase == 'E'){
+                buffer->depth--;
+        }
+        struct trace_event * event = &buffer->events[buffer->written++ & (TRACE_RING_SIZE - 1)];
+        event->timestamp = (now.tv_sec - tracer.start.tv_sec) * 1000000000LL + (now.tv_nsec - tracer.start.tv_nsec);
+        event->requested = requested;
+        event->netted = netted;
+        strcpy(event->id, assembly->id);
+        event->phase = phase;
+        event->kind = kind;
+        event->depth = buffer->depth;
+        if (phase == 'B'){
+                buffer->depth++;
+        }
+}
+
+// runs as each thread that traced exits
+void trace_release(void * buffer){
+        pthread_mutex_lock(&tracer.lock);
+        ((struct trace_buffer *)buffer)->idle = 1;
+        pthread_mutex_unlock(&tracer.lock);
+}
+
+int trace_depth(){
+        struct trace_buffer * buffer = trace_buffer();
+        return buffer == NULL ? 0 : buffer->depth;
+}
+
+// a worker picking up a task carries on at the depth the task was spawned at
+void trace_set_depth(int depth){
+        struct trace_buffer * buffer = trace_buffer();
+        if (buffer != NULL){
+                buffer->depth = depth;
+        }
+}
+
+// a JSON string of "prefix" (trusted) followed by "id" (escaped)
+void trace_print_id(FILE * fp, const char * prefix, const char * id){
+        fputc('"', fp);
+        fputs(prefix, fp);
+        for (const char * c = id; *c != '\0'; c++){
+                if (*c == '"' || *c == '\\'){
+                        fprintf(fp, "\\%c", *c);
+                }
+                else if ((unsigned char)*c < 0x20){
+                        fprintf(fp, "\\u%04x", (unsigned char)*c);
+                }
+                else{
+                        fputc(*c, fp);
+                }
+        }
+        fputc('"', fp);
+}
+
+// Chrome trace-event JSON, one track per thread
+void trace_export(FILE * fp){
+        const char * kinds[] = {"make", "get"};
+        unsigned long dropped = tracer.lost;
+
+        fprintf(fp, "{\"traceEvents\":[\n");
+        int first = 1;
+        for (struct trace_buffer * buffer = tracer.buffers; buffer != NULL; buffer = buffer->next){
+                char name[32];
+                if (buffer->thread == 0){
+                        strcpy(name, "main");
+                }
+                else{
+                        snprintf(name, sizeof(name), "worker %d", buffer->thread);
+                }
+                fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                        first ? "" : ",\n", buffer->thread, name);
+                first = 0;
+
+                unsigned long begin = 0;
+                if (buffer->written > TRACE_RING_SIZE){
+                        begin = buffer->written - TRACE_RING_SIZE;
+                        dropped += begin;
+                }
+                // after a wrap, ends whose begins were overwritten have nothing to close
+                int open = 0;
+                for (unsigned long i = begin; i < buffer->written; i++){
+                        struct trace_event * event = &buffer->events[i & (TRACE_RING_SIZE - 1)];
+                        if (event->phase == 'E'){
+                                if (open == 0){
+                                        dropped++;
+                                        continue;
+                                }
+                                open--;
+                        }
+                        else{
+                                open++;
+                        }
+                        fprintf(fp, ",\n{\"name\":");
+                        trace_print_id(fp, event->kind == TRACE_MAKE ? "make " : "get ", event->id);
+                        fprintf(fp, ",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%lld.%03lld,\"pid\":1,\"tid\":%d,\"args\":{\"assembly\":",
+                                kinds[(int)event->kind], event->phase, event->timestamp / 1000, event->timestamp % 1000, buffer->thread);
+                        trace_print_id(fp, "", event->id);
+                        fprintf(fp, ",\"requested\":%lld,\"netted\":%lld,\"depth\":%d}}", event->requested, event->netted, event->depth);
+                }
+        }
+        fprintf(fp, "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped_events\":%lu}}\n", dropped);
+}
+
+// things related to parallel explosion
+int subtree_unstocked(inventory_t * invp, assembly_t * assembly, unsigned mark){
+        if (assembly->visit_mark == mark){
+                return 1;
+        }
+        assembly->visit_mark = mark;
+
+        // workers only read recipes, so they all have to be resolved up front
+        if (assembly->unit == NULL && unit_demand_build(invp, assembly) == NULL){
+                return 0;
+        }
+        unit_demand_t * unit = assembly->unit;
+        for (int i = 0; i < unit->assembly_count; i++){
+                if (unit->assemblies[i]->on_hand != 0 || !subtree_unstocked(invp, unit->assemblies[i], mark)){
+                        return 0;
+                }
+        }
+        return 1;
+}
+
+int explode_append(struct explode_task * task, const char * text, size_t length){
+        struct explode_segment * segment = task->last;
+        if (grow_array(MEM_SCRATCH, (void **)&segment->text, &segment->capacity, segment->length + length, 1, 4096) != 0){
+                return -1;
+        }
+        memcpy(segment->text + segment->length, text, length);
+        segment->length += length;
+        return 0;
+}
+
+struct explode_task * explode_task_create(assembly_t * assembly, long long n){
+        struct explode_task * task = mem_calloc(MEM_SCRATCH, 1, sizeof(struct explode_task));
+        struct explode_segment * segment = mem_calloc(MEM_SCRATCH, 1, sizeof(struct explode_segment));
+        if (task == NULL || segment == NULL){
+                mem_free(MEM_SCRATCH, task, sizeof(struct explode_task));
+                mem_free(MEM_SCRATCH, segment, sizeof(struct explode_segment));
+                return NULL;
+        }
+        task->assembly = assembly;
+        task->n = n;
+        task->first = segment;
+        task->last = segment;
+        return task;
+}
+
+int explode_push(struct explode_worker * worker, struct explode_task * task){
+        int result = 0;
+        pthread_mutex_lock(&worker->lock);
+        if (worker->bottom == worker->capacity){
+                // sliding the live tasks down, or growing if they fill the deque
+                int live = worker->bottom - worker->top;
+                int capacity = live * 2 > worker->capacity ? worker->capacity * 2 : worker->capacity;
+                struct explode_task ** tasks = capacity == worker->capacity ? worker->tasks : mem_alloc(MEM_SCRATCH, capacity * sizeof(struct explode_task *));
+                if (tasks == NULL){
+                        result = -1;
+                }
+                else{
+                        memmove(tasks, worker->tasks + worker->top, live * sizeof(struct explode_task *));
+                        if (tasks != worker->tasks){
+                                mem_free(MEM_SCRATCH, worker->tasks, worker->capacity * sizeof(struct explode_task *));
+                        }
+                        worker->tasks = tasks;
+                        worker->capacity = capacity;
+                        worker->top = 0;
+                        worker->bottom = live;
+                }
+        }
+        if (result == 0){
+                worker->tasks[worker->bottom++] = task;
+        }
+        pthread_mutex_unlock(&worker->lock);
+        return result;
+}
+
+// the owner takes its newest task, depth first
+struct explode_task * explode_pop(struct explode_worker * worker){
+        struct explode_task * task = NULL;
+        pthread_mutex_lock(&worker->lock);
+        if (worker->bottom > worker->top){
+                task = worker->tasks[--worker->bottom];
+        }
+        pthread_mutex_unlock(&worker->lock);
+        return task;
+}
+
+// thieves take the oldest task, which is usually the biggest
+struct explode_task * explode_steal(struct explode_worker * worker){
+        struct explode_task * task = NULL;
+        pthread_mutex_lock(&worker->lock);
+        if (worker->bottom > worker->top){
+                task = worker->tasks[worker->top++];
+                if (worker->top == worker->bottom){
+                        worker->top = 0;
+                        worker->bottom = 0;
+                }
+        }
+        pthread_mutex_unlock(&worker->lock);
+        return task;
+}
+
+// what make() would do for "n" units of "assembly" with nothing in stock below it, appended to "task"'s output
+int explode_expand(struct explode_worker * worker, struct explode_task * task, assembly_t * assembly, long long n){
+        if (tracing){
+                trace_event('B', TRACE_MAKE, assembly, n, n);
+        }
+        int result = explode_expand_units(worker, task, assembly, n);
+        if (tracing){
+                trace_event('E', TRACE_MAKE, assembly, n, n);
+        }
+        return result;
+}
+
+// explode_expand() without the tracing
+int explode_expand_units(struct explode_worker * worker, struct explode_task * task, assembly_t * assembly, long long n){
+        if (make_report == MAKE_REPORT_EACH){
+                format_make(&worker->record, assembly, n);
+                if (worker->record.failed || explode_append(task, worker->record.data, worker->record.length) != 0){
+                        return -1;
+                }
+        }
+        else{
+                demand_add_made(worker->parts, assembly, n);
+        }
+        if (demand_add_unit(worker->parts, assembly, n) != 0){
+                return -1;
+        }
+
+        unit_demand_t * unit = assembly->unit;
+        for (int i = 0; i < unit->assembly_count; i++){
+                assembly_t * child = unit->assemblies[i];
+                long long quantity;
+                if (mul_overflows(n, unit->assembly_quantity[i], &quantity)){
+                        worker->parts->overflow = 1;
+                        return -1;
+                }
+
+                if (child->tree_nodes < EXPLODE_GRAIN){
+                        if (explode_expand(worker, task, child, quantity) != 0){
+                                return -1;
+                        }
+                        continue;
+                }
+
+                // big enough to hand out: its output goes in its own task, between this task's text so far and what follows
+                struct explode_task * child_task = explode_task_create(child, quantity);
+                struct explode_segment * segment = mem_calloc(MEM_SCRATCH, 1, sizeof(struct explode_segment));
+                if (child_task == NULL || segment == NULL){
+                        mem_free(MEM_SCRATCH, segment, sizeof(struct explode_segment));
+                        explode_task_free(child_task);
+                        return -1;
+                }
+                if (tracing){
+                        child_task->depth = trace_depth();
+                }
+                task->last->child = child_task;
+                task->last->next = segment;
+                task->last = segment;
+                __atomic_add_fetch(&worker->shared->pending, 1, __ATOMIC_SEQ_CST);
+                if (explode_push(worker, child_task) != 0){
+                        // still linked into this task's output, so it is freed with it
+                        __atomic_sub_fetch(&worker->shared->pending, 1, __ATOMIC_SEQ_CST);
+                        return -1;
+                }
+        }
+        return 0;
+}
+
+void * explode_work(void * arg){
+        struct explode_worker * worker = arg;
+        struct explode * shared = worker->shared;
+
+        while (!__atomic_load_n(&shared->failed, __ATOMIC_SEQ_CST)){
+                struct explode_task * task = explode_pop(worker);
+                for (int i = 1; task == NULL && i < shared->worker_count; i++){
+                        task = explode_steal(&shared->workers[(worker->id + i) % shared->worker_count]);
+                }
+                if (task == NULL){
+                        if (__atomic_load_n(&shared->pending, __ATOMIC_SEQ_CST) == 0){
+                                break;
+                        }
+                        sched_yield();
+                        continue;
+                }
+
+                // the root's make() has already traced it, on the thread that called make_parallel()
+                int result;
+                if (tracing){
+                        trace_set_depth(task->depth);
+                }
+                if (task == shared->root){
+                        result = explode_expand_units(worker, task, task->assembly, task->n);
+                }
+                else{
+                        result = explode_expand(worker, task, task->assembly, task->n);
+                }
+                if (result != 0){
+                        __atomic_store_n(&shared->failed, 1, __ATOMIC_SEQ_CST);
+                }
+                __atomic_sub_fetch(&shared->pending, 1, __ATOMIC_SEQ_CST);
+        }
+        return NULL;
+}
+
+// writes out a task's text and its children's, in the order make() would have printed them, then frees them
+// (into "held" instead of standard output if it isn't NULL)
+void explode_emit(struct explode_task * task, int print, struct record * held){
+        struct explode_segment * segment = task->first;
+        while (segment != NULL){
+                // (empty when make lines aren't printed as they happen, see set_make_report())
+                if (print && segment->length > 0 && held != NULL){
+                        record_bytes(held, segment->text, segment->length);
+                }
+                else if (print && segment->length > 0){
+                        fwrite(segment->text, 1, segment->length, stdout);
+                }
+                if (segment->child != NULL){
+                        explode_emit(segment->child, print, held);
+                }
+                struct explode_segment * temp = segment;
+                segment = segment->next;
+                mem_free(MEM_SCRATCH, temp->text, temp->capacity);
+                mem_free(MEM_SCRATCH, temp, sizeof(struct explode_segment));
+        }
+        mem_free(MEM_SCRATCH, task, sizeof(struct explode_task));
+}
+
+void explode_task_free(struct explode_task * task){
+        if (task != NULL){
+                explode_emit(task, 0, NULL);
+        }
+}
+
+int make_parallel(inventory_t * invp, assembly_t * assembly, long long n, demand_t * parts, int worker_count){
+        struct explode shared;
+        pthread_t threads[MAX_WORKERS];
+        int started[MAX_WORKERS] = {0};
+        int result = 0;
+
+        memset(&shared, 0, sizeof(shared));
+        shared.worker_count = worker_count;
+        for (int i = 0; i < worker_count; i++){
+                struct explode_worker * worker = &shared.workers[i];
+                worker->shared = &shared;
+                worker->id = i;
+                pthread_mutex_init(&worker->lock, NULL);
+                worker->capacity = 64;
+                worker->tasks = mem_alloc(MEM_SCRATCH, worker->capacity * sizeof(struct explode_task *));
+                worker->parts = demand_create(invp);
+                if (worker->tasks == NULL || worker->parts == NULL){
+                        result = -1;
+                }
+        }
+
+        struct explode_task * root = explode_task_create(assembly, n);
+        if (root == NULL){
+                result = -1;
+        }
+        shared.root = root;
+
+        // this thread works as worker 0, which moves its trace depth around; the root's children nest under its make()
+        int depth = tracing ? trace_depth() : 0;
+        if (root != NULL){
+                root->depth = depth;
+        }
+
+        if (result == 0 && explode_push(&shared.workers[0], root) != 0){
+                result = -1;
+        }
+        if (result == 0){
+                shared.pending = 1;
+                for (int i = 1; i < worker_count; i++){
+                        started[i] = pthread_create(&threads[i], NULL, explode_work, &shared.workers[i]) == 0;
+                }
+                explode_work(&shared.workers[0]);
+                for (int i = 1; i < worker_count; i++){
+                        if (started[i]){
+                                pthread_join(threads[i], NULL);
+                        }
+                }
+                if (tracing){
+                        trace_set_depth(depth);
+                }
+                if (shared.failed){
+                        result = -1;
+                }
+        }
+
+        // the make lines, in order, then the per-worker parts lists reduced into "parts"
+        if (root != NULL){
+                explode_emit(root, result == 0, parts->undo == NULL ? NULL : &parts->undo->held);
+        }
+        for (int i = 0; i < worker_count; i++){
+                struct explode_worker * worker = &shared.workers[i];
+                if (result == 0 && demand_merge(parts, worker->parts) != 0){
+                        result = -1;
+                }
+                if (worker->parts != NULL && worker->parts->overflow){
+                        parts->overflow = 1;
+                }
+                // tasks left in the deque by a failed run are linked into the output tree, which is already freed
+                demand_free(worker->parts);
+                record_free(&worker->record);
+                mem_free(MEM_SCRATCH, worker->tasks, worker->capacity * sizeof(struct explode_task *));
+                pthread_mutex_destroy(&worker->lock);
+        }
+        if (result != 0 && !parts->overflow){
+                report_error("Memory allocation failed");
+                parts->overflow = 1;
+        }
+        return result;
+}
+
+// things related to demand vectors
+int demand_merge(demand_t * parts, demand_t * other){
+        if (other->touched_count * 4 > other->part_count){
+                // mostly full, so adding the whole vector is cheaper than chasing indexes
+                if (demand_scale_add(parts->quantity, other->quantity, 1, other->part_count) != 0){
+                        parts->overflow = 1;
+                        return -1;
+                }
+        }
+        else{
+                for (int i = 0; i < other->touched_count; i++){
+                        int index = other->touched[i];
+                        if (other->quantity[index] > LLONG_MAX - parts->quantity[index]){
+                                parts->overflow = 1;
+                                return -1;
+                        }
+                        parts->quantity[index] += other->quantity[index];
+                }
+        }
+        for (int i = 0; i < other->touched_count; i++){
+                int index = other->touched[i];
+                if (!parts->part_seen[index]){
+                        parts->part_seen[index] = 1;
+                        parts->touched[parts->touched_count++] = index;
+                }
+        }
+        for (int i = 0; i < other->made_count; i++){
+                demand_add_made(parts, other->made_assemblies[i], other->made[other->made_assemblies[i]->index]);
+        }
+        return 0;
+}
+
+// adds a quantity worked out somewhere else, such as another partition
+// counting units made for the make report; the counts saturate rather than fail, since they are only reported
+void demand_add_made(demand_t * parts, assembly_t * assembly, long long n){
+        long long * made = &parts->made[assembly->index];
+        if (*made == 0){
+                parts->made_assemblies[parts->made_count++] = assembly;
+        }
+        *made = n > LLONG_MAX - *made ? LLONG_MAX : *made + n;
+}
+
+int demand_add_quantity(demand_t * parts, int index, long long quantity){
+        if (quantity > LLONG_MAX - parts->quantity[index]){
+                parts->overflow = 1;
+                return -1;
+        }
+        parts->quantity[index] += quantity;
+        if (!parts->part_seen[index]){
+                parts->part_seen[index] = 1;
+                parts->touched[parts->touched_count++] = index;
+        }
+        return 0;
+}
+
+int mul_overflows(long long a, long long b, long long * product){
+        // both are never negative here
+        if (a != 0 && b > LLONG_MAX / a){
+                return 1;
+        }
+        *product = a * b;
+        return 0;
+}
+
+unit_demand_t * unit_demand_build(inventory_t * invp, assembly_t * assembly){
+        unit_demand_t * unit = mem_calloc(MEM_PLAN, 1, sizeof(unit_demand_t));
+        if (unit == NULL){
+                return NULL;
+        }
+        int item_count = assembly->items->item_count;
+        if (item_count > 0){
+                unit->part_index = mem_alloc(MEM_PLAN, item_count * sizeof(int));
+                unit->part_quantity = mem_alloc(MEM_PLAN, item_count * sizeof(long long));
+                unit->assemblies = mem_alloc(MEM_PLAN, item_count * sizeof(assembly_t *));
+                unit->assembly_quantity = mem_alloc(MEM_PLAN, item_count * sizeof(long long));
+                if (unit->part_index == NULL || unit->part_quantity == NULL || unit->assemblies == NULL || unit->assembly_quantity == NULL){
+                        unit_demand_free(unit, item_count);
+                        return NULL;
+                }
+        }
+
+        // make() has always worked through the recipe back to front
+        item_t ** item_array = to_item_array(item_count, assembly->items->item_list);
+        if (item_array == NULL && item_count > 0){
+                unit_demand_free(unit, item_count);
+                return NULL;
+        }
+        int low = 0;
+        int high = 0;
+        for (int i = item_count - 1; i >= 0; i--){
+                item_t * current_item = item_array[i];
+                if (current_item->id[0] == 'P'){
+                        int index = find_part(invp, current_item->id)->index;
+                        if (unit->part_count == 0 || index < low){
+                                low = index;
+                        }
+                        if (unit->part_count == 0 || index > high){
+                                high = index;
+                        }
+                        if (current_item->quantity > unit->max_quantity){
+                                unit->max_quantity = current_item->quantity;
+                        }
+                        unit->part_index[unit->part_count] = index;
+                        unit->part_quantity[unit->part_count] = current_item->quantity;
+                        unit->part_count++;
+                }
+                else{
+                        unit->assemblies[unit->assembly_count] = find_assembly(invp, current_item->id);
+                        unit->assembly_quantity[unit->assembly_count] = current_item->quantity;
+                        unit->assembly_count++;
+                }
+        }
+        mem_free(MEM_SCRATCH, item_array, item_count * sizeof(item_t *));
+
+        // a dense copy when the parts are close together (they are when a family was imported together),
+        // so adding it is a straight vector operation instead of a scatter
+        if (unit->part_count >= DENSE_MIN_PARTS && high - low + 1 <= unit->part_count * DENSE_MAX_SPREAD){
+                unit->dense = mem_calloc(MEM_PLAN, high - low + 1, sizeof(long long));
+                if (unit->dense != NULL){
+                        unit->low = low;
+                        unit->span = high - low + 1;
+                        for (int i = 0; i < unit->part_count; i++){
+                                unit->dense[unit->part_index[i] - low] = unit->part_quantity[i];
+                        }
+                }
+        }
+
+        assembly->unit = unit;
+        return unit;
+}
+
+void unit_demand_free(unit_demand_t * unit, int item_count){
+        if (unit == NULL){
+                return;
+        }
+        mem_free(MEM_PLAN, unit->part_index, item_count * sizeof(int));
+        mem_free(MEM_PLAN, unit->part_quantity, item_count * sizeof(long long));
+        mem_free(MEM_PLAN, unit->assemblies, item_count * sizeof(assembly_t *));
+        mem_free(MEM_PLAN, unit->assembly_quantity, item_count * sizeof(long long));
+        mem_free(MEM_PLAN, unit->dense, unit->span * sizeof(long long));
+        mem_free(MEM_PLAN, unit, sizeof(unit_demand_t));
+}
+
+demand_t * demand_create(inventory_t * invp){
+        demand_t * parts = mem_calloc(MEM_SCRATCH, 1, sizeof(demand_t));
+        if (parts == NULL){
+                return NULL;
+        }
+        parts->part_count = invp->part_count;
+        parts->assembly_count = invp->assembly_count;
+        // one spare entry each so an empty inventory still gets real allocations
+        parts->quantity = mem_calloc(MEM_SCRATCH, parts->part_count + 1, sizeof(long long));
+        parts->part_seen = mem_calloc(MEM_SCRATCH, parts->part_count + 1, 1);
+        parts->touched = mem_alloc(MEM_SCRATCH, (parts->part_count + 1) * sizeof(int));
+        parts->assembly_seen = mem_calloc(MEM_SCRATCH, parts->assembly_count + 1, 1);
+        parts->seen_assemblies = mem_alloc(MEM_SCRATCH, (parts->assembly_count + 1) * sizeof(int));
+        parts->made = mem_calloc(MEM_SCRATCH, parts->assembly_count + 1, sizeof(long long));
+        parts->made_assemblies = mem_alloc(MEM_SCRATCH, (parts->assembly_count + 1) * sizeof(assembly_t *));
+        if (parts->quantity == NULL || parts->part_seen == NULL || parts->touched == NULL || parts->assembly_seen == NULL
+                        || parts->seen_assemblies == NULL || parts->made == NULL || parts->made_assemblies == NULL){
+                demand_free(parts);
+                return NULL;
+        }
+        return parts;
+}
+
+void demand_free(demand_t * parts){
+        if (parts == NULL){
+                return;
+        }
+        mem_free(MEM_SCRATCH, parts->quantity, (parts->part_count + 1) * sizeof(long long));
+        mem_free(MEM_SCRATCH, parts->part_seen, parts->part_count + 1);
+        mem_free(MEM_SCRATCH, parts->touched, (parts->part_count + 1) * sizeof(int));
+        mem_free(MEM_SCRATCH, parts->assembly_seen, parts->assembly_count + 1);
+        mem_free(MEM_SCRATCH, parts->seen_assemblies, (parts->assembly_count + 1) * sizeof(int));
+        mem_free(MEM_SCRATCH, parts->made, (parts->assembly_count + 1) * sizeof(long long));
+        mem_free(MEM_SCRATCH, parts->made_assemblies, (parts->assembly_count + 1) * sizeof(assembly_t *));
+        mem_free(MEM_SCRATCH, parts, sizeof(demand_t));
+}
+
+int demand_add_unit(demand_t * parts, assembly_t * assembly, long long n){
+        unit_demand_t * unit = assembly->unit;
+        if (unit->part_count == 0){
+                return 0;
+        }
+
+        // if the largest quantity times n fits, every product does
+        long long largest;
+        if (mul_overflows(n, unit->max_quantity, &largest)){
+                parts->overflow = 1;
+                return -1;
+        }
+
+        // the first time this assembly contributes, remembering which parts it touches
+        if (!parts->assembly_seen[assembly->index]){
+                parts->assembly_seen[assembly->index] = 1;
+                parts->seen_assemblies[parts->seen_count++] = assembly->index;
+                for (int i = 0; i < unit->part_count; i++){
+                        int index = unit->part_index[i];
+                        if (!parts->part_seen[index]){
+                                parts->part_seen[index] = 1;
+                                parts->touched[parts->touched_count++] = index;
+                        }
+                }
+        }
+
+        int overflow;
+        if (unit->dense != NULL){
+                overflow = demand_scale_add(parts->quantity + unit->low, unit->dense, n, unit->span);
+        }
+        else{
+                unsigned long long sign = 0;
+                for (int i = 0; i < unit->part_count; i++){
+                        unsigned long long sum = (unsigned long long)parts->quantity[unit->part_index[i]] + (unsigned long long)(n * unit->part_quantity[i]);
+                        sign |= sum;
+                        parts->quantity[unit->part_index[i]] = (long long)(sum & LLONG_MAX);
+                }
+                overflow = (int)(sign >> 63);
+        }
+        if (overflow){
+                parts->overflow = 1;
+                return -1;
+        }
+        return 0;
+}
+
+// accumulator[i] += n * vector[i]; all values are non-negative and n * max(vector) is known to fit.
+// Returns nonzero if any sum overflowed
+int demand_scale_add_scalar(long long * accumulator, const long long * vector, long long n, int count){
+        unsigned long long sign = 0;
+        for (int i = 0; i < count; i++){
+                // two non-negative long longs always fit in an unsigned long long; the top bit means it didn't fit in a long long
+                unsigned long long sum = (unsigned long long)accumulator[i] + (unsigned long long)(vector[i] * n);
+                sign |= sum;
+                accumulator[i] = (long long)(sum & LLONG_MAX);
+        }
+        return (int)(sign >> 63);
+}
+
+#if DEMAND_SIMD
+__attribute__((target("avx2")))
+int demand_scale_add_avx2(long long * accumulator, const long long * vector, long long n, int count){
+        // AVX2 has no 64-bit multiply, so products are built from 32-bit halves:
+        // v * n = lo(v) * lo(n) + ((hi(v) * lo(n) + lo(v) * hi(n)) << 32), mod 2^64, exact since it fits
+        __m256i n_low = _mm256_set1_epi64x(n & 0xffffffffLL);
+        __m256i n_high = _mm256_set1_epi64x((long long)((unsigned long long)n >> 32));
+        __m256i sign = _mm256_setzero_si256();
+        int i = 0;
+        for (; i + 4 <= count; i += 4){
+                __m256i v = _mm256_loadu_si256((const __m256i *)(vector + i));
+                __m256i a = _mm256_loadu_si256((const __m256i *)(accumulator + i));
+                __m256i v_high = _mm256_srli_epi64(v, 32);
+                __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(v_high, n_low), _mm256_mul_epu32(v, n_high));
+                __m256i product = _mm256_add_epi64(_mm256_mul_epu32(v, n_low), _mm256_slli_epi64(cross, 32));
+                __m256i sum = _mm256_add_epi64(a, product);
+                sign = _mm256_or_si256(sign, sum);
+                _mm256_storeu_si256((__m256i *)(accumulator + i), sum);
+        }
+        int overflow = _mm256_movemask_pd(_mm256_castsi256_pd(sign)) != 0;
+        return demand_scale_add_scalar(accumulator + i, vector + i, n, count - i) | overflow;
+}
+#endif
+
+int demand_scale_add(long long * accumulator, const long long * vector, long long n, int count){
+        // picking the kernel the first time through
+        static int (*kernel)(long long *, const long long *, long long, int) = NULL;
+        if (kernel == NULL){
+                kernel = demand_scale_add_scalar;
+#if DEMAND_SIMD
+                __builtin_cpu_init();
+                if (__builtin_cpu_supports("avx2")){
+                        kernel = demand_scale_add_avx2;
+                }
+#endif
+        }
+        return kernel(accumulator, vector, n, count);
+}
+
+// the make report of a request, unless make lines were printed as they happened
+void print_made(demand_t * parts){
+        if (make_report == MAKE_REPORT_EACH || parts->made_count == 0){
+                return;
+        }
+        if (make_report == MAKE_REPORT_SUMMARY){
+                long long units = 0;
+                for (int i = 0; i < parts->made_count; i++){
+                        long long made = parts->made[parts->made_assemblies[i]->index];
+                        units = made > LLONG_MAX - units ? LLONG_MAX : units + made;
+                }
+                emit_make_summary(units, parts->made_count);
+                return;
+        }
+
+        // sorting by assembly ID, in the workspace's buffer
+        assembly_t ** assembly_array = (assembly_t **)workspace_sort(&workspace, parts->made_count);
+        if (assembly_array == NULL){
+                report_error("Memory allocation failed");
+                return;
+        }
+        memcpy(assembly_array, parts->made_assemblies, parts->made_count * sizeof(assembly_t *));
+        qsort(assembly_array, parts->made_count, sizeof(assembly_t *), assembly_compare);
+        for (int i = 0; i < parts->made_count; i++){
+                emit_make(assembly_array[i], parts->made[assembly_array[i]->index]);
+        }
+}
+
+void print_parts_needed(inventory_t * invp, demand_t * parts){
+        if (parts->touched_count == 0){
+                return;
+        }
+
+        // sorting by part ID, in the workspace's buffer
+        part_t ** part_array = (part_t **)workspace_sort(&workspace, parts->touched_count);
+        if (part_array == NULL){
+                report_error("Memory allocation failed");
+                return;
+        }
+        for (int i = 0; i < parts->touched_count; i++){
+                part_array[i] = invp->part_table[parts->touched[i]];
+        }
+        qsort(part_array, parts->touched_count, sizeof(part_t *), part_compare);
+
+        if (output_format == FORMAT_TEXT){
+                fprintf(stdout, "Parts needed:\n");
+                fprintf(stdout, "-------------\n");
+                fprintf(stdout, "Part ID     quantity\n");
+                fprintf(stdout, "=========== ========\n");
+                for (int i = 0; i < parts->touched_count; i++){
+                        fprintf(stdout, "%-11s %8lld\n", part_array[i]->id, parts->quantity[part_array[i]->index]);
+                }
+        }
+        else{
+                record_begin(&output_record, RECORD_PARTS_NEEDED);
+                record_list_begin(&output_record, "parts");
+                for (int i = 0; i < parts->touched_count; i++){
+                        record_item_begin(&output_record);
+                        record_string(&output_record, "part", part_array[i]->id);
+                        record_number(&output_record, "quantity", parts->quantity[part_array[i]->index]);
+                        record_item_end(&output_record);
+                }
+                record_list_end(&output_record);
+                record_end(&output_record);
+                record_write(&output_record);
+        }
+}
+
+// things related to the planning workspace
+demand_t * workspace_demand(struct workspace * ws, inventory_t * invp){
+        // only in a partition worker: a partition call served while one of its own requests still holds the workspace
+        // (a restock waiting on another partition's get) plans in a vector of its own, which workspace_release() frees
+        if (ws->parts_busy){
+                return demand_create(invp);
+        }
+        demand_t * parts = &ws->parts;
+
+        // growing ahead of the inventory, so adding a few parts or assemblies doesn't mean reallocating every time
+        if (invp->part_count >= ws->part_capacity || invp->assembly_count >= ws->assembly_capacity){
+                workspace_demand_free(ws);
+                int part_capacity = invp->part_count + invp->part_count / 2 + 16;
+                int assembly_capacity = invp->assembly_count + invp->assembly_count / 2 + 16;
+                parts->quantity = mem_calloc(MEM_WORKSPACE, part_capacity, sizeof(long long));
+                parts->part_seen = mem_calloc(MEM_WORKSPACE, part_capacity, 1);
+                parts->touched = mem_alloc(MEM_WORKSPACE, part_capacity * sizeof(int));
+                parts->assembly_seen = mem_calloc(MEM_WORKSPACE, assembly_capacity, 1);
+                parts->seen_assemblies = mem_alloc(MEM_WORKSPACE, assembly_capacity * sizeof(int));
+                parts->made = mem_calloc(MEM_WORKSPACE, assembly_capacity, sizeof(long long));
+                parts->made_assemblies = mem_alloc(MEM_WORKSPACE, assembly_capacity * sizeof(assembly_t *));
+                ws->part_capacity = part_capacity;
+                ws->assembly_capacity = assembly_capacity;
+                if (parts->quantity == NULL || parts->part_seen == NULL || parts->touched == NULL || parts->assembly_seen == NULL
+                                || parts->seen_assemblies == NULL || parts->made == NULL || parts->made_assemblies == NULL){
+                        workspace_demand_free(ws);
+                        return NULL;
+                }
+        }
+
+        parts->part_count = invp->part_count;
+        parts->assembly_count = invp->assembly_count;
+        parts->touched_count = 0;
+        parts->seen_count = 0;
+        parts->made_count = 0;
+        parts->overflow = 0;
+        parts->fork = NULL;
+        parts->undo = NULL;
+        parts->threaded = 0;
+        ws->parts_busy = 1;
+        return parts;
+}
+
+void workspace_release(struct workspace * ws, demand_t * parts){
+        if (parts != &ws->parts){
+                demand_free(parts);
+                return;
+        }
+        // every nonzero quantity belongs to a touched part, so only those need clearing
+        for (int i = 0; i < parts->touched_count; i++){
+                parts->quantity[parts->touched[i]] = 0;
+                parts->part_seen[parts->touched[i]] = 0;
+        }
+        for (int i = 0; i < parts->seen_count; i++){
+                parts->assembly_seen[parts->seen_assemblies[i]] = 0;
+        }
+        for (int i = 0; i < parts->made_count; i++){
+                parts->made[parts->made_assemblies[i]->index] = 0;
+        }
+        ws->parts_busy = 0;
+}
+
+void workspace_demand_free(struct workspace * ws){
+        demand_t * parts = &ws->parts;
+        mem_free(MEM_WORKSPACE, parts->quantity, ws->part_capacity * sizeof(long long));
+        mem_free(MEM_WORKSPACE, parts->part_seen, ws->part_capacity);
+        mem_free(MEM_WORKSPACE, parts->touched, ws->part_capacity * sizeof(int));
+        mem_free(MEM_WORKSPACE, parts->assembly_seen, ws->assembly_capacity);
+        mem_free(MEM_WORKSPACE, parts->seen_assemblies, ws->assembly_capacity * sizeof(int));
+        mem_free(MEM_WORKSPACE, parts->made, ws->assembly_capacity * sizeof(long long));
+        mem_free(MEM_WORKSPACE, parts->made_assemblies, ws->assembly_capacity * sizeof(assembly_t *));
+        parts->quantity = NULL;
+        parts->part_seen = NULL;
+        parts->touched = NULL;
+        parts->assembly_seen = NULL;
+        parts->seen_assemblies = NULL;
+        parts->made = NULL;
+        parts->made_assemblies = NULL;
+        ws->part_capacity = 0;
+        ws->assembly_capacity = 0;
+}
+
+void ** workspace_sort(struct workspace * ws, size_t count){
+        if (count > ws->sort_capacity){
+                size_t capacity = count + count / 2 + 16;
+                void ** bigger = mem_alloc(MEM_WORKSPACE, capacity * sizeof(void *));
+                if (bigger == NULL){
+                        return NULL;
+                }
+                mem_free(MEM_WORKSPACE, ws->sort, ws->sort_capacity * sizeof(void *));
+                ws->sort = bigger;
+                ws->sort_capacity = capacity;
+        }
+        return ws->sort;
+}
+
+items_needed_t * workspace_order(struct workspace * ws){
+        items_clear(&ws->order);
+        return &ws->order;
+}
+
+void workspace_free(struct workspace * ws){
+        workspace_demand_free(ws);
+        mem_free(MEM_WORKSPACE, ws->sort, ws->sort_capacity * sizeof(void *));
+        ws->sort = NULL;
+        ws->sort_capacity = 0;
+
+        items_clear(&ws->order);
+        item_t * current_item = ws->order.spare;
+        while (current_item != NULL){
+                item_t * temp = current_item;
+                current_item = current_item->next;
+                mem_free(MEM_ITEM, temp, sizeof(item_t));
+        }
+        ws->order.spare = NULL;
+}
+
+// things related to restocking in parallel
+// the root of an assembly's component, halving the path there along the way
+assembly_t * component_of(assembly_t * assembly){
+        while (assembly->component != assembly){
+                assembly->component = assembly->component->component;
+                assembly = assembly->component;
+        }
+        return assembly;
+}
+
+// a new assembly starts a component of its own, then joins the component of each of its sub-assemblies
+void join_components(inventory_t * invp, assembly_t * assembly){
+        assembly->component = assembly;
+        assembly->component_size = 1;
+        item_t * current_item = assembly->items->item_list;
+        while (current_item != NULL){
+                if (current_item->id[0] == 'A'){
+                        assembly_t * root = component_of(assembly);
+                        assembly_t * other = component_of(find_assembly(invp, current_item->id));
+                        if (root != other){
+                                // the smaller tree goes under the bigger one, so the trees stay shallow
+                                if (root->component_size < other->component_size){
+                                        assembly_t * temp = root;
+                                        root = other;
+                                        other = temp;
+                                }
+                                other->component = root;
+                                root->component_size += other->component_size;
+                        }
+                }
+                current_item = current_item->next;
+        }
+}
+
+// restock() of every assembly with the components spread across lanes; returns 1 if the restock was done, or 0 to
+// leave it to the one-thread loop (not enough work, or a lane that couldn't finish and was rolled back)
+int restock_parallel(inventory_t * invp, assembly_t ** assemblies, int count, demand_t * parts){
+        // make() and get() on a lane mustn't trace, or reach another partition
+        if (tracing || partitions.count > 0 || partitions.self >= 0){
+                return 0;
+        }
+
+        // what the low assemblies take to make from nothing, and how many components they are in
+        long long nodes = 0;
+        int components = 0;
+        unsigned mark = ++visit_mark;
+        for (int i = 0; i < count; i++){
+                assembly_t * assembly = assemblies[i];
+                if (is_low(assembly->on_hand, assembly->capacity)){
+                        nodes = assembly->tree_nodes > LLONG_MAX - nodes ? LLONG_MAX : nodes + assembly->tree_nodes;
+                        assembly_t * root = component_of(assembly);
+                        if (root->visit_mark != mark){
+                                root->visit_mark = mark;
+                                components++;
+                        }
+                }
+        }
+        int lane_count = worker_count((size_t)nodes, RESTOCK_GRAIN);
+        if (lane_count > components){
+                lane_count = components;
+        }
+        if (lane_count < 2){
+                return 0;
+        }
+
+        if (count > parallel_restock.step_capacity){
+                int capacity = count + count / 2 + 16;
+                struct restock_step * bigger = mem_alloc(MEM_WORKSPACE, capacity * sizeof(struct restock_step));
+                if (bigger == NULL){
+                        return 0;
+                }
+                mem_free(MEM_WORKSPACE, parallel_restock.steps, parallel_restock.step_capacity * sizeof(struct restock_step));
+                parallel_restock.steps = bigger;
+                parallel_restock.step_capacity = capacity;
+        }
+        struct restock_step * steps = parallel_restock.steps;
+        struct restock_lane * lanes = parallel_restock.lanes;
+        parallel_restock.invp = invp;
+        parallel_restock.assemblies = assemblies;
+        parallel_restock.count = count;
+
+        int result = 1;
+        for (int l = 0; l < lane_count; l++){
+                struct restock_lane * lane = &lanes[l];
+                lane->parts = workspace_demand(&lane->workspace, invp);
+                if (lane->parts == NULL){
+                        result = 0;
+                        continue;
+                }
+                lane->parts->undo = &lane->undo;
+                lane->parts->threaded = 1;
+                undo_begin(&lane->undo);
+                lane->load = 0;
+                lane->replayed_held = 0;
+                lane->replayed_changes = 0;
+                lane->failed = 0;
+        }
+
+        if (result){
+                // each component to the lane with the fewest assemblies so far, roots first so the rest can follow them
+                for (int i = 0; i < count; i++){
+                        if (component_of(assemblies[i]) == assemblies[i]){
+                                struct restock_lane * lightest = &lanes[0];
+                                for (int l = 1; l < lane_count; l++){
+                                        if (lanes[l].load < lightest->load){
+                                                lightest = &lanes[l];
+                                        }
+                                }
+                                steps[i].lane = lightest;
+                                lightest->load += assemblies[i]->component_size;
+                        }
+                }
+                for (int i = 0; i < count; i++){
+                        steps[i].lane = steps[component_of(assemblies[i])->index].lane;
+                }
+
+                pthread_t threads[MAX_WORKERS];
+                int started[MAX_WORKERS] = {0};
+                for (int l = 1; l < lane_count; l++){
+                        started[l] = pthread_create(&threads[l], NULL, restock_lane_work, &lanes[l]) == 0;
+                }
+                restock_lane_work(&lanes[0]);
+                for (int l = 1; l < lane_count; l++){
+                        if (started[l]){
+                                pthread_join(threads[l], NULL);
+                        }
+                        else{
+                                restock_lane_work(&lanes[l]);
+                        }
+                }
+
+                // the parts lists added up before anything is replayed: a sum that overflows means one thread would
+                // have stopped partway, and that is left to the one-thread loop to do exactly
+                for (int l = 0; l < lane_count; l++){
+                        if (lanes[l].failed || (l > 0 && demand_merge(lanes[0].parts, lanes[l].parts) != 0)){
+                                result = 0;
+                        }
+                }
+        }
+
+        if (result){
+                // the output and changes of each assembly in turn, LIFO, as one thread would have made them
+                for (int i = count - 1; i >= 0; i--){
+                        struct restock_lane * lane = steps[i].lane;
+                        if (steps[i].held > lane->replayed_held){
+                                fwrite(lane->undo.held.data + lane->replayed_held, 1, steps[i].held - lane->replayed_held, stdout);
+                                lane->replayed_held = steps[i].held;
+                        }
+                        for (; lane->replayed_changes < steps[i].changes; lane->replayed_changes++){
+                                struct undo_entry * entry = &lane->undo.entries[lane->replayed_changes];
+                                entry->assembly->on_hand = entry->old_on_hand;
+                                set_on_hand(entry->assembly, entry->new_on_hand);
+                        }
+                }
+                demand_merge(parts, lanes[0].parts);
+        }
+
+        for (int l = 0; l < lane_count; l++){
+                struct restock_lane * lane = &lanes[l];
+                if (lane->parts == NULL){
+                        continue;
+                }
+                if (result){
+                        undo_begin(&lane->undo);
+                }
+                else{
+                        undo_rollback(&lane->undo);
+                }
+                workspace_release(&lane->workspace, lane->parts);
+                lane->parts = NULL;
+        }
+        return result;
+}
+
+// one lane's assemblies, restocked LIFO, with where the lane was after each one noted in its step
+void * restock_lane_work(void * arg){
+        struct restock_lane * lane = arg;
+        struct restock_step * steps = parallel_restock.steps;
+        struct undo_log * undo = &lane->undo;
+        for (int i = parallel_restock.count - 1; i >= 0 && !lane->failed; i--){
+                if (steps[i].lane != lane){
+                        continue;
+                }
+                assembly_t * assembly = parallel_restock.assemblies[i];
+                long long on_hand = assembly->on_hand;
+                if (is_low(on_hand, assembly->capacity)){
+                        long long amt_needed = assembly->capacity - on_hand;
+                        format_restock(&undo->line, assembly->id, amt_needed);
+                        record_bytes(&undo->held, undo->line.data, undo->line.length);
+                        if (make(parallel_restock.invp, assembly, amt_needed, lane->parts) != 0
+                                        || change_on_hand(lane->parts, assembly, assembly->on_hand + amt_needed) != 0){
+                                lane->failed = 1;
+                        }
+                }
+                steps[i].held = undo->held.length;
+                steps[i].changes = undo->count;
+        }
+        if (undo->failed || undo->held.failed || undo->line.failed){
+                lane->failed = 1;
+        }
+        return NULL;
+}
+
+void parallel_restock_free(void){
+        for (int l = 0; l < MAX_WORKERS; l++){
+                workspace_free(&parallel_restock.lanes[l].workspace);
+                undo_free(&parallel_restock.lanes[l].undo);
+        }
+        mem_free(MEM_WORKSPACE, parallel_restock.steps, parallel_restock.step_capacity * sizeof(struct restock_step));
+        parallel_restock.steps = NULL;
+        parallel_restock.step_capacity = 0;
+}
+
+// things related to output
+int set_output_format(char * mode){
+        if (strcmp(mode, "text") == 0){
+                output_format = FORMAT_TEXT;
+        }
+        else if (strcmp(mode, "jsonl") == 0){
+                output_format = FORMAT_JSONL;
+        }
+        else if (strcmp(mode, "binary") == 0){
+                output_format = FORMAT_BINARY;
+        }
+        else{
+                return -1;
+        }
+        return 0;
+}
+
+int set_make_report(char * mode){
+        if (strcmp(mode, "each") == 0){
+                make_report = MAKE_REPORT_EACH;
+        }
+        else if (strcmp(mode, "aggregate") == 0){
+                make_report = MAKE_REPORT_AGGREGATE;
+        }
+        else if (strcmp(mode, "summary") == 0){
+                make_report = MAKE_REPORT_SUMMARY;
+        }
+        else{
+                return -1;
+        }
+        return 0;
+}
+
+// makes room for "extra" more bytes; on failure the record is marked failed and later writes are ignored
+int record_reserve(struct record * record, size_t extra){
+        if (record->failed){
+                return -1;
+        }
+        if (grow_array(MEM_SCRATCH, (void **)&record->data, &record->capacity, record->length + extra, 1, 256) != 0){
+                record->failed = 1;
+                return -1;
+        }
+        return 0;
+}
+
+void record_bytes(struct record * record, const void * bytes, size_t length){
+        if (record_reserve(record, length) != 0){
+                return;
+        }
+        memcpy(record->data + record->length, bytes, length);
+        record->length += length;
+}
+
+// writes "key": with a comma in front if needed
+void record_key(struct record * record, const char * key){
+        if (record->separate){
+                record_bytes(record, ",", 1);
+        }
+        record_bytes(record, "\"", 1);
+        record_bytes(record, key, strlen(key));
+        record_bytes(record, "\":", 2);
+        record->separate = 1;
+}
+
+// a JSON string, with quotes, backslashes and control characters escaped
+void record_quoted(struct record * record, const char * value){
+        record_bytes(record, "\"", 1);
+        const char * run = value; // start of the characters that need no escaping
+        for (const char * c = value; *c != '\0'; c++){
+                if (*c != '"' && *c != '\\' && (unsigned char)*c >= 0x20){
+                        continue;
+                }
+                record_bytes(record, run, c - run);
+                char escape[8];
+                int length;
+                if (*c == '"' || *c == '\\'){
+                        length = snprintf(escape, sizeof(escape), "\\%c", *c);
+                }
+                else{
+                        length = snprintf(escape, sizeof(escape), "\\u%04x", (unsigned char)*c);
+                }
+                record_bytes(record, escape, length);
+                run = c + 1;
+        }
+        record_bytes(record, run, strlen(run));
+        record_bytes(record, "\"", 1);
+}
+
+void record_begin(struct record * record, enum record_type type){
+        const char * names[RECORD_TYPES] = {NULL, "request", "error", "make", "restock", "parts_needed", "inventory", "assembly", "change_sequence", "part", "imported", "memory", "memory_limit", "help", "scenario", "reservation",
+                                            "make_summary", "reloaded"};
+
+        record->length = 0;
+        record->failed = 0;
+        record->separate = 0;
+        if (output_format == FORMAT_BINARY){
+                uint32_t length = 0; // filled in by record_end()
+                uint8_t type_byte = type;
+                record_bytes(record, &length, sizeof(length));
+                record_bytes(record, &type_byte, sizeof(type_byte));
+        }
+        else{
+                record_bytes(record, "{", 1);
+                record_key(record, "type");
+                record_quoted(record, names[type]);
+        }
+}
+
+void record_string(struct record * record, const char * key, const char * value){
+        if (output_format == FORMAT_BINARY){
+                size_t length = strlen(value);
+                uint16_t length_field = length > UINT16_MAX ? UINT16_MAX : length;
+                record_bytes(record, &length_field, sizeof(length_field));
+                record_bytes(record, value, length_field);
+        }
+        else{
+                record_key(record, key);
+                record_quoted(record, value);
+        }
+}
+
+void record_number(struct record * record, const char * key, long long value){
+        if (output_format == FORMAT_BINARY){
+                int64_t number = value;
+                record_bytes(record, &number, sizeof(number));
+        }
+        else{
+                char text[24];
+                int length = snprintf(text, sizeof(text), "%lld", value);
+                record_key(record, key);
+                record_bytes(record, text, length);
+        }
+}
+
+void record_flag(struct record * record, const char * key, int value){
+        if (output_format == FORMAT_BINARY){
+                uint8_t flag = value != 0;
+                record_bytes(record, &flag, sizeof(flag));
+        }
+        else{
+                record_key(record, key);
+                if (value){
+                        record_bytes(record, "true", 4);
+                }
+                else{
+                        record_bytes(record, "false", 5);
+                }
+        }
+}
+
+// lists don't nest, so one open list per record is all that's tracked
+void record_list_begin(struct record * record, const char * key){
+        record->list_count = 0;
+        if (output_format == FORMAT_BINARY){
+                uint32_t count = 0; // filled in by record_list_end()
+                record->list_start = record->length;
+                record_bytes(record, &count, sizeof(count));
+        }
+        else{
+                record_key(record, key);
+                record_bytes(record, "[", 1);
+                record->separate = 0;
+        }
+}
+
+void record_item_begin(struct record * record){
+        record->list_count++;
+        if (output_format != FORMAT_BINARY){
+                if (record->separate){
+                        record_bytes(record, ",", 1);
+                }
+                record_bytes(record, "{", 1);
+                record->separate = 0;
+        }
+}
+
+void record_item_end(struct record * record){
+        if (output_format != FORMAT_BINARY){
+                record_bytes(record, "}", 1);
+                record->separate = 1;
+        }
+}
+
+void record_list_end(struct record * record){
+        if (output_format == FORMAT_BINARY){
+                uint32_t count = record->list_count;
+                if (!record->failed){
+                        memcpy(record->data + record->list_start, &count, sizeof(count));
+                }
+        }
+        else{
+                record_bytes(record, "]", 1);
+                record->separate = 1;
+        }
+}
+
+void record_end(struct record * record){
+        if (output_format == FORMAT_BINARY){
+                uint32_t length = record->length - sizeof(length);
+                if (!record->failed){
+                        memcpy(record->data, &length, sizeof(length));
+                }
+        }
+        else{
+                record_bytes(record, "}\n", 2);
+        }
+}
+
+// replaces the record's contents with formatted text, for "text" mode
+void record_text(struct record * record, const char * format, ...){
+        va_list args;
+        va_start(args, format);
+        va_list copy;
+        va_copy(copy, args);
+        int length = vsnprintf(NULL, 0, format, copy);
+        va_end(copy);
+
+        record->length = 0;
+        record->failed = 0;
+        if (length >= 0 && record_reserve(record, length + 1) == 0){
+                vsnprintf(record->data, length + 1, format, args);
+                record->length = length;
+        }
+        va_end(args);
+}
+
+void record_write(struct record * record){
+        if (!record->failed){
+                fwrite(record->data, 1, record->length, stdout);
+        }
+}
+
+void record_free(struct record * record){
+        mem_free(MEM_SCRATCH, record->data, record->capacity);
+        record->data = NULL;
+        record->length = 0;
+        record->capacity = 0;
+}
+
+// "!!!" on standard error in "text" mode, an error record in the output stream otherwise
+void report_error(const char * format, ...){
+        char message[512];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(message, sizeof(message), format, args);
+        va_end(args);
+
+        if (output_format == FORMAT_TEXT){
+                fprintf(stderr, "!!! %s\n", message);
+                return;
+        }
+        // errors can come from worker threads, so this record is its own
+        struct record record = {.data = NULL, .length = 0, .capacity = 0, .failed = 0};
+        record_begin(&record, RECORD_ERROR);
+        record_string(&record, "message", message);
+        record_end(&record);
+        record_write(&record);
+        record_free(&record);
+}
+
+// headings and other lines that only the text tables have
+void emit_text(const char * format, ...){
+        if (output_format != FORMAT_TEXT){
+                return;
+        }
+        va_list args;
+        va_start(args, format);
+        vfprintf(stdout, format, args);
+        va_end(args);
+}
+
+void emit_request(char * line){
+        if (output_format == FORMAT_TEXT){
+                fprintf(stdout, "+ %s\n", line);
+                return;
+        }
+        record_begin(&output_record, RECORD_REQUEST);
+        record_string(&output_record, "line", line);
+        record_end(&output_record);
+        record_write(&output_record);
+}
+
+// the parallel explosion keeps make events as bytes until it knows where they go
+void format_make(struct record * record, assembly_t * assembly, long long n){
+        if (output_format == FORMAT_TEXT){
+                record_text(record, ">>> make %lld units of assembly %s\n", n, assembly->id);
+                return;
+        }
+        record_begin(record, RECORD_MAKE);
+        record_string(record, "assembly", assembly->id);
+        record_number(record, "quantity", n);
+        record_end(record);
+}
+
+void emit_make(assembly_t * assembly, long long n){
+        if (output_format == FORMAT_TEXT){
+                fprintf(stdout, ">>> make %lld units of assembly %s\n", n, assembly->id);
+                return;
+        }
+        format_make(&output_record, assembly, n);
+        record_write(&output_record);
+}
+void emit_make_summary(long long units, int assemblies){
+        if (output_format == FORMAT_TEXT){
+                fprintf(stdout, ">>> made %lld units of %d assemblies\n", units, assemblies);
+                return;
+        }
+        record_begin(&output_record, RECORD_MAKE_SUMMARY);
+        record_number(&output_record, "units", units);
+        record_number(&output_record, "assemblies", assemblies);
+        record_end(&output_record);
+        record_write(&output_record);
+}
+
+void format_restock(struct record * record, char * id, long long n){
+        if (output_format == FORMAT_TEXT){
+                record_text(record, ">>> restocking assembly %s with %lld items\n", id, n);
+                return;
+        }
+        record_begin(record, RECORD_RESTOCK);
+        record_string(record, "assembly", id);
+        record_number(record, "quantity", n);
+        record_end(record);
+}
+void emit_restock(char * id, long long n){
+        if (output_format == FORMAT_TEXT){
+                fprintf(stdout, ">>> restocking assembly %s with %lld items\n", id, n);
+                return;
+        }
+        format_restock(&output_record, id, n);
+        record_write(&output_record);
+}
+
+// the reserved and available columns only appear while there are reservations
+void emit_inventory_header(){
+        if (reservations.count > 0){
+                emit_text("Assembly ID Capacity On Hand Reserved Available\n");
+                emit_text("=========== ======== ======= ======== =========\n");
+        }
+        else{
+                emit_text("Assembly ID Capacity On Hand\n");
+                emit_text("=========== ======== =======\n");
+        }
+}
+
+// "on_hand" is passed in, since a simulation's differs from the assembly's
+void emit_inventory_row(assembly_t * assembly, long long on_hand){
+        int low = is_low(on_hand, assembly->capacity);
+        long long available = on_hand > assembly->reserved ? on_hand - assembly->reserved : 0;
+        if (output_format == FORMAT_TEXT && reservations.count > 0){
+                fprintf(stdout, "%-11s %8lld %7lld %8lld %9lld%s\n", assembly->id, assembly->capacity, on_hand, assembly->reserved, available, low ? "*" : "");
+                return;
+        }
+        if (output_format == FORMAT_TEXT){
+                fprintf(stdout, "%-11s %8lld %7lld%s\n", assembly->id, assembly->capacity, on_hand, low ? "*" : "");
+                return;
+        }
+        record_begin(&output_record, RECORD_INVENTORY);
+        record_string(&output_record, "assembly", assembly->id);
+        record_number(&output_record, "capacity", assembly->capacity);
+        record_number(&output_record, "on_hand", on_hand);
+        record_flag(&output_record, "low", low);
+        record_number(&output_record, "reserved", assembly->reserved);
+        record_number(&output_record, "available", available);
+        record_end(&output_record);
+        record_write(&output_record);
+}
+
+// "item_array" is the recipe sorted by ID, or NULL if it has no parts
+void emit_assembly(assembly_t * assembly, item_t ** item_array, int item_count){
+        if (output_format == FORMAT_TEXT){
+                fprintf(stdout, "Assembly ID:  %s\n", assembly->id);
+                fprintf(stdout, "bin capacity: %lld\n", assembly->capacity);
+                fprintf(stdout, "on-hand:      %lld\n", assembly->on_hand);
+                if (reservations.count > 0){
+                        fprintf(stdout, "reserved:     %lld\n", assembly->reserved);
+                        fprintf(stdout, "available:    %lld\n", assembly->on_hand > assembly->reserved ? assembly->on_hand - assembly->reserved : 0);
+                }
+                if (item_array != NULL){
+                        fprintf(stdout, "Parts list:\n");
+                        fprintf(stdout, "-----------\n");
+                        fprintf(stdout, "Part ID     quantity\n");
+                        fprintf(stdout, "=========== ========\n");
+                        for (int i = 0; i < item_count; i++){
+                                fprintf(stdout, "%-15s %4lld\n", item_array[i]->id, item_array[i]->quantity);
+                        }
+                }
+                return;
+        }
+        record_begin(&output_record, RECORD_ASSEMBLY);
+        record_string(&output_record, "assembly", assembly->id);
+        record_number(&output_record, "capacity", assembly->capacity);
+        record_number(&output_record, "on_hand", assembly->on_hand);
+        record_number(&output_record, "reserved", assembly->reserved);
+        record_number(&output_record, "available", assembly->on_hand > assembly->reserved ? assembly->on_hand - assembly->reserved : 0);
+        record_list_begin(&output_record, "items");
+        for (int i = 0; i < item_count; i++){
+                record_item_begin(&output_record);
+                record_string(&output_record, "item", item_array[i]->id);
+                record_number(&output_record, "quantity", item_array[i]->quantity);
+                record_item_end(&output_record);
+        }
+        record_list_end(&output_record);
+        record_end(&output_record);
+        record_write(&output_record);
+}
+
+void emit_scenario(int number, char * text){
+        if (output_format == FORMAT_TEXT){
+                fprintf(stdout, "Scenario %d: %s\n", number, text);
+                return;
+        }
+        record_begin(&output_record, RECORD_SCENARIO);
+        record_number(&output_record, "scenario", number);
+        record_string(&output_record, "line", text);
+        record_end(&output_record);
+        record_write(&output_record);
+}
+
+void emit_reservation(long id, char * state, long long ttl){
+        if (output_format == FORMAT_TEXT && ttl > 0){
+                fprintf(stdout, ">>> %s R%ld for %lld seconds\n", state, id, ttl);
+                return;
+        }
+        if (output_format == FORMAT_TEXT){
+                fprintf(stdout, ">>> %s R%ld\n", state, id);
+                return;
+        }
+        char rid[24];
+        snprintf(rid, sizeof(rid), "R%ld", id);
+        record_begin(&output_record, RECORD_RESERVATION);
+        record_string(&output_record, "reservation", rid);
+        record_string(&output_record, "state", state);
+        record_number(&output_record, "ttl", ttl);
+        record_end(&output_record);
+        record_write(&output_record);
+}
+
+void emit_change_sequence(long seq){
+        if (output_format == FORMAT_TEXT){
+                fprintf(stdout, "change sequence: %ld\n", seq);
+                return;
+        }
+        record_begin(&output_record, RECORD_CHANGE_SEQUENCE);
+        record_number(&output_record, "seq", seq);
+        record_end(&output_record);
+        record_write(&output_record);
+}
+
+void emit_part(char * id){
+        if (output_format == FORMAT_TEXT){
+                fprintf(stdout, "%s\n", id);
+                return;
+        }
+        record_begin(&output_record, RECORD_PART);
+        record_string(&output_record, "part", id);
+        record_end(&output_record);
+        record_write(&output_record);
+}
+
+void emit_imported(char * filename, char * kind, int count){
+        if (output_format == FORMAT_TEXT){
+                fprintf(stdout, ">>> imported %d %s from %s\n", count, kind, filename);
+                return;
+        }
+        record_begin(&output_record, RECORD_IMPORTED);
+        record_string(&output_record, "file", filename);
+        record_string(&output_record, "kind", kind);
+        record_number(&output_record, "count", count);
+        record_end(&output_record);
+        record_write(&output_record);
+}
+
+void emit_reloaded(char * filename, int part_count, int assembly_count){
+        if (output_format == FORMAT_TEXT){
+                fprintf(stdout, ">>> reloaded catalog from %s: %d parts, %d assemblies\n", filename, part_count, assembly_count);
+                return;
+        }
+        record_begin(&output_record, RECORD_RELOADED);
+        record_string(&output_record, "file", filename);
+        record_number(&output_record, "parts", part_count);
+        record_number(&output_record, "assemblies", assembly_count);
+        record_end(&output_record);
+        record_write(&output_record);
+}
+
+void emit_memory_row(const char * name, size_t objects, size_t live_bytes, size_t peak_bytes){
+        if (output_format == FORMAT_TEXT){
+                fprintf(stdout, "%-15s %8zu %12zu %12zu\n", name, objects, live_bytes, peak_bytes);
+                return;
+        }
+        record_begin(&output_record, RECORD_MEMORY);
+        record_string(&output_record, "structure", name);
+        record_number(&output_record, "objects", objects);
+        record_number(&output_record, "live_bytes", live_bytes);
+        record_number(&output_record, "peak_bytes", peak_bytes);
+        record_end(&output_record);
+        record_write(&output_record);
+}
+
+void emit_help(char * request){
+        if (output_format == FORMAT_TEXT){
+                fprintf(stdout, "    %s\n", request);
+                return;
+        }
+        record_begin(&output_record, RECORD_HELP);
+        record_string(&output_record, "request", request);
+        record_end(&output_record);
+        record_write(&output_record);
+}
+
+// things related to parts
+part_t ** to_part_array(int count, part_t * part_list){
+        part_t ** part_array = (part_t **)mem_alloc(MEM_SCRATCH, count * sizeof(part_t *));
+        if (part_array == NULL){
+                report_error("Memory allocation failed");
+                return NULL;
+        }
+
+        part_t * current = part_list;
+        for (int i = 0; i < count; i++){
+                part_array[i] = current;
+                current = current->next;
+        }
+        return part_array;
+}
+
+int part_compare(const void * a, const void * b){
+        // need to type-cast the provided parameters to be part_t
+        // need to dereference once to point to the object itself
+        const part_t * p1 = *(const part_t**)a;
+        const part_t * p2 = *(const part_t**)b;
+        return strcmp(p1->id, p2->id);
+}
+
+// things related to assemblies
+assembly_t ** to_assembly_array(int count, assembly_t * assembly_list){
+        assembly_t ** assembly_array = (assembly_t **)mem_alloc(MEM_SCRATCH, count * sizeof(assembly_t *));
+        if (assembly_array == NULL){
+                report_error("Memory allocation failed");
+                return NULL;
+        }
+
+        assembly_t * current = assembly_list;
+        for (int i = 0; i < count; i++){
+                assembly_array[i] = current;
+                current = current->next;
+        }
+        return assembly_array;
+}
+
+int assembly_compare(const void * a, const void * b){
+        const assembly_t * a1 = *(const assembly_t**)a;
+        const assembly_t * a2 = *(const assembly_t**)b;
+        return strcmp(a1->id, a2->id);
+}
+
+// things related to items_needed_t
+item_t ** to_item_array(int count, item_t * item_list){
+        item_t ** item_array = mem_alloc(MEM_SCRATCH, count * sizeof(item_t *));
+        if (item_array == NULL){
+                report_error("Memory allocation failed");
+                return NULL;
+        }
+
+        item_t * current = item_list;
+        for (int i = 0; i < count; i++){
+                item_array[i] = current;
+                current = current->next;
+        }
+        return item_array;
+}
+
+int item_compare(const void * a, const void * b){
+        const item_t * i1 = *(const item_t**)a;
+        const item_t * i2 = *(const item_t**)b;
+        return strcmp(i1->id, i2->id);
+}
+
+// things related to memory accounting
+// bytes malloc actually set aside for "pointer", beyond the "size" that was asked for
+size_t mem_overhead(void * pointer, size_t size){
+#ifdef __GLIBC__
+        // the usable size plus the chunk header
+        if (pointer != NULL){
+                return malloc_usable_size(pointer) + sizeof(size_t) - size;
+        }
+#endif
+        // estimate: a size_t header, rounded up to 16 bytes
+        return ((size + sizeof(size_t) + 15) & ~(size_t)15) - size;
+}
+
+void mem_account(enum mem_kind kind, void * pointer, size_t size){
+        size_t total = 0;
+
+        pthread_mutex_lock(&mem_lock);
+        mem_allocations++;
+        mem_usage[kind].live_bytes += size;
+        mem_usage[kind].live_count++;
+        mem_usage[kind].overhead_bytes += mem_overhead(pointer, size);
+        if (mem_usage[kind].live_bytes > mem_usage[kind].peak_bytes){
+                mem_usage[kind].peak_bytes = mem_usage[kind].live_bytes;
+        }
+
+        for (int i = 0; i < MEM_KINDS; i++){
+                total += mem_usage[i].live_bytes + mem_usage[i].overhead_bytes;
+        }
+        if (total > mem_peak){
+                mem_peak = total;
+        }
+        pthread_mutex_unlock(&mem_lock);
+}
+
+void * mem_alloc(enum mem_kind kind, size_t size){
+        void * pointer = malloc(size);
+        if (pointer != NULL){
+                mem_account(kind, pointer, size);
+        }
+        return pointer;
+}
+
+void * mem_calloc(enum mem_kind kind, size_t count, size_t size){
+        void * pointer = calloc(count, size);
+        if (pointer != NULL){
+                mem_account(kind, pointer, count * size);
+        }
+        return pointer;
+}
+
+void mem_free(enum mem_kind kind, void * pointer, size_t size){
+        if (pointer == NULL){
+                return;
+        }
+        pthread_mutex_lock(&mem_lock);
+        mem_usage[kind].live_bytes -= size;
+        mem_usage[kind].live_count--;
+        mem_usage[kind].overhead_bytes -= mem_overhead(pointer, size);
+        pthread_mutex_unlock(&mem_lock);
+        free(pointer);
+}
+
+// grows "*array" of "*capacity" elements, each "size" bytes, until it holds at least "needed": "first" elements to start
+// with, doubling after that. The elements are copied over, and a failed allocation leaves the array as it was
+int grow_array(enum mem_kind kind, void ** array, size_t * capacity, size_t needed, size_t size, size_t first){
+        if (needed <= *capacity){
+                return 0;
+        }
+        size_t bigger_capacity = *capacity == 0 ? first : *capacity * 2;
+        while (bigger_capacity < needed){
+                bigger_capacity *= 2;
+        }
+        void * bigger = mem_alloc(kind, bigger_capacity * size);
+        if (bigger == NULL){
+                return -1;
+        }
+        if (*capacity > 0){
+                memcpy(bigger, *array, *capacity * size);
+        }
+        mem_free(kind, *array, *capacity * size);
+        *array = bigger;
+        *capacity = bigger_capacity;
+        return 0;
+}
+
+int mem_over_limit(size_t size){
+        if (mem_limit == 0){
+                return 0;
+        }
+
+        size_t total = size + mem_overhead(NULL, size);
+        pthread_mutex_lock(&mem_lock);
+        for (int i = 0; i < MEM_KINDS; i++){
+                total += mem_usage[i].live_bytes + mem_usage[i].overhead_bytes;
+        }
+        pthread_mutex_unlock(&mem_lock);
+        return total > mem_limit;
+}
+
+// things related to the change feed
+int is_low(long long on_hand, long long capacity){
+        return on_hand < capacity / 2 + 1;
+}
+
+void set_on_hand(assembly_t * assembly, long long on_hand){
+        long long old_on_hand = assembly->on_hand;
+        if (on_hand == old_on_hand){
+                return;
+        }
+        assembly->on_hand = on_hand;
+        if (replication.role == REPLICATION_PRIMARY){
+                journal_append(JOURNAL_ON_HAND, assembly->id, on_hand, NULL);
+        }
+
+        long seq = ++feed.last_seq;
+        assembly->changed_seq = seq;
+
+        // making room for the log the first time around
+        if (feed.log == NULL){
+                feed.log = mem_alloc(MEM_FEED, CHANGE_LOG_SIZE * sizeof(struct change));
+        }
+        if (feed.log != NULL){
+                struct change * change = &feed.log[seq & (CHANGE_LOG_SIZE - 1)];
+                change->seq = seq;
+                change->assembly = assembly;
+                change->old_on_hand = old_on_hand;
+                change->new_on_hand = on_hand;
+                if (seq - feed.first_seq >= CHANGE_LOG_SIZE){
+                        feed.first_seq = seq - CHANGE_LOG_SIZE + 1;
+                }
+        }
+        else{
+                feed.first_seq = seq + 1;
+        }
+
+        // pushing to the subscribers; they are flushed once per request by feed_flush()
+        int crossed = is_low(old_on_hand, assembly->capacity) != is_low(on_hand, assembly->capacity);
+        for (int i = 0; i < feed.subscriber_count; i++){
+                struct subscriber * subscriber = &feed.subscribers[i];
+                if (!subscriber->low_only){
+                        fprintf(subscriber->fp, "%ld %s %lld %lld\n", seq, assembly->id, old_on_hand, on_hand);
+                }
+                if (crossed){
+                        fprintf(subscriber->fp, "%ld %s %s\n", seq, assembly->id, is_low(on_hand, assembly->capacity) ? "low" : "ok");
+                }
+        }
+}
+
+void feed_flush(){
+        for (int i = 0; i < feed.subscriber_count; i++){
+                fflush(feed.subscribers[i].fp);
+        }
+}
+
+void feed_reset(){
+        feed.first_seq = feed.last_seq + 1;
+        for (int i = 0; i < feed.subscriber_count; i++){
+                fprintf(feed.subscribers[i].fp, "%ld cleared\n", feed.last_seq);
+        }
+}
+
+// things related to the ID indexes
+size_t id_hash(const char * id){
+        // FNV-1a
+        size_t hash = (size_t)2166136261u;
+        while (*id != '\0'){
+                hash ^= (unsigned char)*id++;
+                hash *= (size_t)16777619u;
+        }
+        return hash;
+}
+
+void * index_lookup(struct id_index * index, const char * id){
+        if (index->capacity == 0){
+                return NULL;
+        }
+        size_t mask = index->capacity - 1;
+        size_t slot = id_hash(id) & mask;
+        while (index->slots[slot] != NULL){
+                if (strcmp((const char *)index->slots[slot], id) == 0){
+                        return index->slots[slot];
+                }
+                slot = (slot + 1) & mask;
+        }
+        return NULL;
+}
+
+int index_reserve(struct id_index * index, size_t count){
+        // keeping the table at most half full
+        size_t capacity = index->capacity == 0 ? 16 : index->capacity;
+        while (capacity < count * 2){
+                capacity *= 2;
+        }
+        if (capacity == index->capacity){
+                return 0;
+        }
+
+        void ** slots = mem_calloc(MEM_INDEX, capacity, sizeof(void *));
+        if (slots == NULL){
+                return -1;
+        }
+
+        // rehashing the old entries into the new table
+        for (size_t i = 0; i < index->capacity; i++){
+                if (index->slots[i] != NULL){
+                        size_t slot = id_hash((const char *)index->slots[i]) & (capacity - 1);
+                        while (slots[slot] != NULL){
+                                slot = (slot + 1) & (capacity - 1);
+                        }
+                        slots[slot] = index->slots[i];
+                }
+        }
+        mem_free(MEM_INDEX, index->slots, index->capacity * sizeof(void *));
+        index->slots = slots;
+        index->capacity = capacity;
+        return 0;
+}
+
+int index_insert(struct id_index * index, void * entry){
+        if (index_reserve(index, index->count + 1) != 0){
+                return -1;
+        }
+        size_t mask = index->capacity - 1;
+        size_t slot = id_hash((const char *)entry) & mask;
+        while (index->slots[slot] != NULL){
+                slot = (slot + 1) & mask;
+        }
+        index->slots[slot] = entry;
+        index->count++;
+        return 0;
+}
+
+void index_clear(struct id_index * index){
+        mem_free(MEM_INDEX, index->slots, index->capacity * sizeof(void *));
+        index->slots = NULL;
+        index->capacity = 0;
+        index->count = 0;
+}
+
+// things related to bulk import
+int worker_count(size_t work, size_t grain){
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        size_t workers = work / grain + 1;
+
+        // INVENTORY_THREADS overrides the CPU count
+        char * threads = getenv("INVENTORY_THREADS");
+        if (threads != NULL){
+                cpus = atol(threads);
+        }
+
+        if (cpus < 1){
+                cpus = 1;
+        }
+        if (workers > (size_t)cpus){
+                workers = (size_t)cpus;
+        }
+        if (workers > MAX_WORKERS){
+                workers = MAX_WORKERS;
+        }
+        return (int)workers;
+}
+
+char * read_file(char * filename, size_t * size){
+        FILE * fp = fopen(filename, "rb");
+        if (fp == NULL){
+                report_error("%s: cannot open file", filename);
+                return NULL;
+        }
+
+        // reading in blocks, since the file may be a pipe; there is always room for one more byte and the terminator
+        size_t capacity = 0;
+        size_t length = 0;
+        char * buffer = NULL;
+        do {
+                if (grow_array(MEM_SCRATCH, (void **)&buffer, &capacity, length + 2, 1, 1 << 16) != 0){
+                        report_error("Memory allocation failed");
+                        mem_free(MEM_SCRATCH, buffer, capacity);
+                        fclose(fp);
+                        return NULL;
+                }
+                length += fread(buffer + length, 1, capacity - length - 1, fp);
+        } while (length == capacity - 1);
+        if (ferror(fp)){
+                report_error("%s: read error", filename);
+                mem_free(MEM_SCRATCH, buffer, capacity);
+                fclose(fp);
+                return NULL;
+        }
+        fclose(fp);
+
+        buffer[length] = '\0';
+        *size = capacity;
+        return buffer;
+}
+
+void import_add_error(struct import_chunk * chunk, int line, const char * format, ...){
+        if (grow_array(MEM_SCRATCH, (void **)&chunk->errors, &chunk->error_capacity, chunk->error_count + 1, sizeof(struct import_error), 16) != 0){
+                chunk->failed = 1;
+                return;
+        }
+
+        va_list args;
+        va_start(args, format);
+        chunk->errors[chunk->error_count].line = line;
+        vsnprintf(chunk->errors[chunk->error_count].message, sizeof(chunk->errors[0].message), format, args);
+        va_end(args);
+        chunk->error_count++;
+}
+
+// splits the next comma-separated field off of "*cursor", trimmed; returns NULL when there are none left
+char * import_next_field(char ** cursor){
+        char * field = *cursor;
+        if (field == NULL){
+                return NULL;
+        }
+        char * comma = strchr(field, ',');
+        if (comma != NULL){
+                *comma = '\0';
+                *cursor = comma + 1;
+        }
+        else{
+                *cursor = NULL;
+        }
+        return trim(field);
+}
+
+// parses a whole-string, non-negative integer; returns -1 if it isn't one
+long long import_number(char * text){
+        char * end;
+        if (text[0] < '0' || text[0] > '9'){
+                return -1;
+        }
+        errno = 0;
+        long long value = strtoll(text, &end, 10);
+        if (*end != '\0' || errno == ERANGE){
+                return -1;
+        }
+        return value;
+}
+
+void * import_parse_chunk(void * arg){
+        struct import_chunk * chunk = arg;
+        char * line = chunk->start;
+
+        while (line < chunk->end && !chunk->failed){
+                char * newline = memchr(line, '\n', chunk->end - line);
+                char * next = newline == NULL ? chunk->end : newline + 1;
+                int line_number = ++chunk->line_count;
+                if (newline != NULL){
+                        *newline = '\0';
+                }
+
+                // handling in case there is a comment
+                char * comment_pos = strchr(line, '#');
+                if (comment_pos != NULL){
+                        *comment_pos = '\0';
+                }
+                char * cursor = trim(line);
+                line = next;
+                if (cursor[0] == '\0'){
+                        continue;
+                }
+
+                char * id = import_next_field(&cursor);
+                char kind = chunk->assemblies ? 'A' : 'P';
+                const char * kind_name = chunk->assemblies ? "assembly" : "part";
+                if (id[0] != kind){
+                        import_add_error(chunk, line_number, "%s: %s ID must start with '%c'", id, kind_name, kind);
+                        continue;
+                }
+                if (strlen(id) > ID_MAX){
+                        import_add_error(chunk, line_number, "%.*s: %s ID too long", ID_MAX, id, kind_name);
+                        continue;
+                }
+
+                struct import_record record;
+                strcpy(record.id, id);
+                record.line = line_number;
+                record.capacity = 0;
+                record.first_component = chunk->component_count;
+                record.component_count = 0;
+
+                if (!chunk->assemblies){
+                        if (cursor != NULL){
+                                import_add_error(chunk, line_number, "%s: unexpected fields after part ID", id);
+                                continue;
+                        }
+                }
+                else{
+                        char * capacity_string = import_next_field(&cursor);
+                        if (capacity_string == NULL){
+                                import_add_error(chunk, line_number, "%s: missing capacity", id);
+                                continue;
+                        }
+                        record.capacity = import_number(capacity_string);
+                        if (record.capacity < 0){
+                                import_add_error(chunk, line_number, "%.16s: illegal capacity for ID %s", capacity_string, id);
+                                continue;
+                        }
+
+                        // the recipe
+                        int bad = 0;
+                        char * item_id;
+                        while (!bad && (item_id = import_next_field(&cursor)) != NULL){
+                                char * quantity_string = import_next_field(&cursor);
+                                if (quantity_string == NULL){
+                                        import_add_error(chunk, line_number, "%.16s: missing quantity", item_id);
+                                        bad = 1;
+                                        break;
+                                }
+                                if (strlen(item_id) > ID_MAX){
+                                        import_add_error(chunk, line_number, "%.*s: part/assembly ID too long", ID_MAX, item_id);
+                                        bad = 1;
+                                        break;
+                                }
+                                long long quantity = import_number(quantity_string);
+                                if (quantity <= 0){
+                                        import_add_error(chunk, line_number, "%.16s: illegal quantity for ID %s", quantity_string, item_id);
+                                        bad = 1;
+                                        break;
+                                }
+
+                                if (grow_array(MEM_SCRATCH, (void **)&chunk->components, &chunk->component_capacity, chunk->component_count + 1,
+                                                sizeof(struct import_component), 256) != 0){
+                                        chunk->failed = 1;
+                                        bad = 1;
+                                        break;
+                                }
+                                strcpy(chunk->components[chunk->component_count].id, item_id);
+                                chunk->components[chunk->component_count].quantity = quantity;
+                                chunk->component_count++;
+                                record.component_count++;
+                        }
+                        if (bad){
+                                chunk->component_count = record.first_component;
+                                continue;
+                        }
+                }
+
+                if (grow_array(MEM_SCRATCH, (void **)&chunk->records, &chunk->record_capacity, chunk->record_count + 1, sizeof(struct import_record), 256) != 0){
+                        chunk->failed = 1;
+                        break;
+                }
+                chunk->records[chunk->record_count++] = record;
+        }
+        return NULL;
+}
+
+int import_load(char * filename, int assemblies, struct import_chunk ** chunks_out, int * chunk_count_out){
+        size_t buffer_size;
+        char * buffer = read_file(filename, &buffer_size);
+        if (buffer == NULL){
+                return -1;
+        }
+        size_t length = strlen(buffer);
+
+        int chunk_count = worker_count(length, IMPORT_CHUNK_MIN);
+        struct import_chunk * chunks = mem_calloc(MEM_SCRATCH, chunk_count, sizeof(struct import_chunk));
+        if (chunks == NULL){
+                report_error("Memory allocation failed");
+                mem_free(MEM_SCRATCH, buffer, buffer_size);
+                return -1;
+        }
+
+        // splitting the file into roughly equal chunks that end on line boundaries
+        char * start = buffer;
+        for (int i = 0; i < chunk_count; i++){
+                char * end = buffer + length * (i + 1) / chunk_count;
+                if (end < start){
+                        end = start;
+                }
+                if (i == chunk_count - 1){
+                        end = buffer + length;
+                }
+                else{
+                        char * newline = memchr(end, '\n', buffer + length - end);
+                        end = newline == NULL ? buffer + length : newline + 1;
+                }
+                chunks[i].start = start;
+                chunks[i].end = end;
+                chunks[i].assemblies = assemblies;
+                start = end;
+        }
+
+        // parsing the chunks in parallel; the first one runs on this thread
+        pthread_t threads[MAX_WORKERS];
+        int started[MAX_WORKERS] = {0};
+        for (int i = 1; i < chunk_count; i++){
+                started[i] = pthread_create(&threads[i], NULL, import_parse_chunk, &chunks[i]) == 0;
+        }
+        import_parse_chunk(&chunks[0]);
+        for (int i = 1; i < chunk_count; i++){
+                if (started[i]){
+                        pthread_join(threads[i], NULL);
+                }
+                else{
+                        import_parse_chunk(&chunks[i]);
+                }
+        }
+        mem_free(MEM_SCRATCH, buffer, buffer_size);
+
+        // turning chunk-relative line numbers into file line numbers
+        int first_line = 0;
+        int failed = 0;
+        for (int i = 0; i < chunk_count; i++){
+                for (int j = 0; j < chunks[i].record_count; j++){
+                        chunks[i].records[j].line += first_line;
+                        chunks[i].records[j].chunk = i;
+                }
+                for (int j = 0; j < chunks[i].error_count; j++){
+                        chunks[i].errors[j].line += first_line;
+                }
+                first_line += chunks[i].line_count;
+                failed |= chunks[i].failed;
+        }
+        if (failed){
+                report_error("Memory allocation failed");
+                import_free(chunks, chunk_count);
+                return -1;
+        }
+
+        *chunks_out = chunks;
+        *chunk_count_out = chunk_count;
+        return 0;
+}
+
+void import_free(struct import_chunk * chunks, int chunk_count){
+        for (int i = 0; i < chunk_count; i++){
+                mem_free(MEM_SCRATCH, chunks[i].records, chunks[i].record_capacity * sizeof(struct import_record));
+                mem_free(MEM_SCRATCH, chunks[i].components, chunks[i].component_capacity * sizeof(struct import_component));
+                mem_free(MEM_SCRATCH, chunks[i].errors, chunks[i].error_capacity * sizeof(struct import_error));
+        }
+        mem_free(MEM_SCRATCH, chunks, chunk_count * sizeof(struct import_chunk));
+}
+
+// gathers every record, sorted by ID and then by line, so duplicates sit next to each other
+struct import_record ** import_sorted(struct import_chunk * chunks, int chunk_count, int * count_out){
+        int count = 0;
+        for (int i = 0; i < chunk_count; i++){
+                count += chunks[i].record_count;
+        }
+        struct import_record ** sorted = mem_alloc(MEM_SCRATCH, (count + 1) * sizeof(struct import_record *));
+        if (sorted == NULL){
+                return NULL;
+        }
+        int k = 0;
+        for (int i = 0; i < chunk_count; i++){
+                for (int j = 0; j < chunks[i].record_count; j++){
+                        sorted[k++] = &chunks[i].records[j];
+                }
+        }
+        qsort(sorted, count, sizeof(struct import_record *), import_record_compare);
+        *count_out = count;
+        return sorted;
+}
+
+int import_record_compare(const void * a, const void * b){
+        const struct import_record * r1 = *(const struct import_record **)a;
+        const struct import_record * r2 = *(const struct import_record **)b;
+        int order = strcmp(r1->id, r2->id);
+        if (order != 0){
+                return order;
+        }
+        return (r1->line > r2->line) - (r1->line < r2->line);
+}
+
+int import_error_compare(const void * a, const void * b){
+        const struct import_error * e1 = *(const struct import_error **)a;
+        const struct import_error * e2 = *(const struct import_error **)b;
+        return (e1->line > e2->line) - (e1->line < e2->line);
+}
+
+// an allocation failed partway through appending: what came before it stays, the rest of the file doesn't
+void import_report_stopped(char * filename, char * kind, int added, int count){
+        report_error("Memory allocation failed");
+        report_error("%s: import stopped after %d of %d %s", filename, added, count, kind);
+}
+
+// prints every error in line order; returns how many there were
+int import_report_errors(char * filename, struct import_chunk * chunks, int chunk_count, char * request){
+        int count = 0;
+        for (int i = 0; i < chunk_count; i++){
+                count += chunks[i].error_count;
+        }
+        if (count == 0){
+                return 0;
+        }
+
+        struct import_error ** errors = mem_alloc(MEM_SCRATCH, count * sizeof(struct import_error *));
+        if (errors != NULL){
+                int k = 0;
+                for (int i = 0; i < chunk_count; i++){
+                        for (int j = 0; j < chunks[i].error_count; j++){
+                                errors[k++] = &chunks[i].errors[j];
+                        }
+                }
+                qsort(errors, count, sizeof(struct import_error *), import_error_compare);
+                for (int i = 0; i < count; i++){
+                        report_error("%s:%d: %s", filename, errors[i]->line, errors[i]->message);
+                }
+                mem_free(MEM_SCRATCH, errors, count * sizeof(struct import_error *));
+        }
+        report_error("%s: %d error(s) -- %s canceled", filename, count, request);
+        return count;
+}
+
+// things related to catalog reloads
+void reload_catalog(char * filename){
+        size_t text_size;
+        char * text = read_file(filename, &text_size);
+        if (text == NULL){
+                return;
+        }
+        char * name = mem_alloc(MEM_SCRATCH, strlen(filename) + 1);
+        struct import_chunk * errors = mem_calloc(MEM_SCRATCH, 1, sizeof(struct import_chunk));
+        if (name == NULL || errors == NULL){
+                report_error("Memory allocation failed");
+                mem_free(MEM_SCRATCH, text, text_size);
+                mem_free(MEM_SCRATCH, name, name == NULL ? 0 : strlen(filename) + 1);
+                mem_free(MEM_SCRATCH, errors, sizeof(struct import_chunk));
+                return;
+        }
+        strcpy(name, filename);
+        catalog_reload.filename = name;
+        catalog_reload.text = text;
+        catalog_reload.text_size = text_size;
+        catalog_reload.errors = errors;
+        catalog_reload.built = 0;
+        catalog_reload.building = 1;
+
+        // without a thread the catalog is built right here, and still only published before the next request
+        catalog_reload.started = pthread_create(&catalog_reload.thread, NULL, catalog_build, NULL) == 0;
+        if (!catalog_reload.started){
+                catalog_build(NULL);
+        }
+}
+
+// on the builder thread: only "catalog_reload.next" and "catalog_reload.errors" are touched until "built" is set
+void * catalog_build(void * arg){
+        (void)arg;
+        char * line = catalog_reload.text;
+        int line_number = 0;
+        while (*line != '\0' && !catalog_reload.errors->failed){
+                char * newline = strchr(line, '\n');
+                char * rest = newline != NULL ? newline + 1 : line + strlen(line);
+                if (newline != NULL){
+                        *newline = '\0';
+                }
+                line_number++;
+
+                // the same comments and blank lines as in a request file
+                char * comment = strchr(line, '#');
+                if (comment != NULL){
+                        *comment = '\0';
+                }
+                char * trimmed = trim(line);
+                if (trimmed[0] != '\0'){
+                        catalog_build_line(&catalog_reload.next, catalog_reload.errors, line_number, trimmed);
+                }
+                line = rest;
+        }
+        __atomic_store_n(&catalog_reload.built, 1, __ATOMIC_RELEASE);
+        return NULL;
+}
+
+// one addPart or addAssembly line, checked as main() and add_part()/add_assembly() would, but with the errors kept by line
+void catalog_build_line(inventory_t * invp, struct import_chunk * errors, int line_number, char * line){
+        char * save;
+        char * request = strtok_r(line, " \t", &save);
+        char * id = strtok_r(NULL, " \t", &save);
+        int assembly = strcmp(request, "addAssembly") == 0;
+        if (!assembly && strcmp(request, "addPart") != 0){
+                import_add_error(errors, line_number, "%s: not a catalog request", request);
+                return;
+        }
+        if (id == NULL){
+                import_add_error(errors, line_number, "Invalid input");
+                return;
+        }
+        if (id[0] != (assembly ? 'A' : 'P')){
+                import_add_error(errors, line_number, "%s: %s ID must start with '%c'", id, assembly ? "assembly" : "part", assembly ? 'A' : 'P');
+                return;
+        }
+        if (strlen(id) > ID_MAX){
+                import_add_error(errors, line_number, "%s: %s ID too long", id, assembly ? "assembly" : "part");
+                return;
+        }
+        if (assembly ? find_assembly(invp, id) != NULL : find_part(invp, id) != NULL){
+                import_add_error(errors, line_number, "%s: duplicate %s ID", id, assembly ? "assembly" : "part");
+                return;
+        }
+
+        if (!assembly){
+                if (mem_over_limit(sizeof(struct part))){
+                        import_add_error(errors, line_number, "%s: memory limit exceeded", id);
+                }
+                else if (part_create(invp, id) == NULL){
+                        errors->failed = 1;
+                }
+                return;
+        }
+
+        char * capacityString = strtok_r(NULL, " \t", &save);
+        if (capacityString == NULL){
+                import_add_error(errors, line_number, "Invalid input");
+                return;
+        }
+        long long capacity = atoll(capacityString);
+        if (capacity < 0){
+                import_add_error(errors, line_number, "%lld: illegal capacity for ID %s", capacity, id);
+                return;
+        }
+        items_needed_t * items = mem_calloc(MEM_ITEMS_NEEDED, 1, sizeof(items_needed_t));
+        if (items == NULL){
+                errors->failed = 1;
+                return;
+        }
+        char * item_id;
+        while ((item_id = strtok_r(NULL, " \t", &save)) != NULL){
+                char * quantityString = strtok_r(NULL, " \t", &save);
+                if (quantityString == NULL){
+                        import_add_error(errors, line_number, "Invalid input");
+                        free_items(items);
+                        return;
+                }
+                long long quantity = atoll(quantityString);
+                if (find_part(invp, item_id) == NULL && find_assembly(invp, item_id) == NULL){
+                        import_add_error(errors, line_number, "%s: part/assembly ID is not in the inventory", item_id);
+                        free_items(items);
+                        return;
+                }
+                if (quantity <= 0){
+                        import_add_error(errors, line_number, "%lld: illegal quantity for ID %s", quantity, item_id);
+                        free_items(items);
+                        return;
+                }
+                if (add_item(items, item_id, quantity) != 0){
+                        if (lookup_item(items->item_list, item_id) != NULL){
+                                import_add_error(errors, line_number, "%lld: illegal quantity for ID %s", quantity, item_id);
+                        }
+                        else{
+                                errors->failed = 1;
+                        }
+                        free_items(items);
+                        return;
+                }
+        }
+        if (mem_over_limit(sizeof(struct assembly))){
+                import_add_error(errors, line_number, "%s: memory limit exceeded", id);
+                free_items(items);
+        }
+        else if (assembly_create(invp, id, capacity, items) == NULL){
+                errors->failed = 1;
+                free_items(items);
+        }
+}
+
+void catalog_poll(int wait){
+        if (catalog_reload.retired != NULL){
+                catalog_reclaim(0);
+        }
+        if (!catalog_reload.building || (!wait && !__atomic_load_n(&catalog_reload.built, __ATOMIC_ACQUIRE))){
+                return;
+        }
+        if (catalog_reload.started){
+                pthread_join(catalog_reload.thread, NULL);
+                catalog_reload.started = 0;
+        }
+
+        // a file with any error leaves the catalog as it was, like an import
+        if (import_report_errors(catalog_reload.filename, catalog_reload.errors, 1, "reload") == 0){
+                if (catalog_reload.errors->failed){
+                        report_error("Memory allocation failed");
+                        report_error("%s: reload canceled", catalog_reload.filename);
+                }
+                else{
+                        catalog_publish();
+                }
+        }
+        catalog_discard();
+}
+
+// puts "catalog_reload.next" in place of "inv", between two requests
+void catalog_publish(){
+        inventory_t * next = &catalog_reload.next;
+
+        // a reservation holds stock of its assemblies, so they have to carry over
+        for (int level = 0; level < WHEEL_LEVELS; level++){
+                for (int slot = 0; slot < WHEEL_SLOTS; slot++){
+                        for (struct reservation * reservation = reservations.slots[level][slot]; reservation != NULL; reservation = reservation->next){
+                                for (int i = 0; i < reservation->line_count; i++){
+                                        char * id = reservation->lines[i].assembly->id;
+                                        if (find_assembly(next, id) == NULL){
+                                                report_error("%s: reserved by R%ld, but not in %s -- reload canceled", id, reservation->id,
+                                                             catalog_reload.filename);
+                                                return;
+                                        }
+                                }
+                        }
+                }
+        }
+
+        // stock, and the change it last came from, carry over by ID
+        for (assembly_t * assembly = next->assembly_list; assembly != NULL; assembly = assembly->next){
+                assembly_t * old = find_assembly(&inv, assembly->id);
+                if (old != NULL){
+                        assembly->on_hand = old->on_hand;
+                        assembly->reserved = old->reserved;
+                        assembly->changed_seq = old->changed_seq;
+                }
+        }
+        for (int level = 0; level < WHEEL_LEVELS; level++){
+                for (int slot = 0; slot < WHEEL_SLOTS; slot++){
+                        for (struct reservation * reservation = reservations.slots[level][slot]; reservation != NULL; reservation = reservation->next){
+                                for (int i = 0; i < reservation->line_count; i++){
+                                        reservation->lines[i].assembly = find_assembly(next, reservation->lines[i].assembly->id);
+                                }
+                        }
+                }
+        }
+        if (feed.log != NULL){
+                for (long seq = feed.first_seq; seq <= feed.last_seq; seq++){
+                        struct change * change = &feed.log[seq & (CHANGE_LOG_SIZE - 1)];
+                        assembly_t * assembly = find_assembly(next, change->assembly->id);
+                        if (assembly != NULL){
+                                change->assembly = assembly;
+                        }
+                }
+        }
+
+        // the old catalog goes, except for dropped assemblies the change feed still points at
+        inventory_t old = inv;
+        inv = *next;
+        *next = (inventory_t){.part_list = NULL, .part_count = 0, .assembly_list = NULL, .assembly_count = 0};
+        assembly_t ** link = &old.assembly_list;
+        while (*link != NULL){
+                assembly_t * assembly = *link;
+                if (assembly->changed_seq >= feed.first_seq && find_assembly(&inv, assembly->id) == NULL){
+                        *link = assembly->next;
+                        assembly->next = catalog_reload.retired;
+                        catalog_reload.retired = assembly;
+                }
+                else{
+                        link = &assembly->next;
+                }
+        }
+        catalog_free(&old);
+
+        // a replica starts over from the new catalog
+        if (replication.role == REPLICATION_PRIMARY){
+                journal_append(JOURNAL_CLEAR, "", 0, NULL);
+                for (part_t * part = inv.part_list; part != NULL; part = part->next){
+                        journal_append(JOURNAL_PART, part->id, 0, NULL);
+                }
+                for (assembly_t * assembly = inv.assembly_list; assembly != NULL; assembly = assembly->next){
+                        journal_append(JOURNAL_ASSEMBLY, assembly->id, assembly->capacity, assembly->items);
+                }
+                for (assembly_t * assembly = inv.assembly_list; assembly != NULL; assembly = assembly->next){
+                        if (assembly->on_hand != 0){
+                                journal_append(JOURNAL_ON_HAND, assembly->id, assembly->on_hand, NULL);
+                        }
+                }
+        }
+        emit_reloaded(catalog_reload.filename, inv.part_count, inv.assembly_count);
+}
+
+// frees what catalog_poll() has finished with, and the new catalog too if it wasn't published
+void catalog_discard(){
+        catalog_free(&catalog_reload.next);
+        import_free(catalog_reload.errors, 1);
+        mem_free(MEM_SCRATCH, catalog_reload.text, catalog_reload.text_size);
+        mem_free(MEM_SCRATCH, catalog_reload.filename, strlen(catalog_reload.filename) + 1);
+        catalog_reload.errors = NULL;
+        catalog_reload.text = NULL;
+        catalog_reload.filename = NULL;
+        catalog_reload.building = 0;
+        catalog_reload.built = 0;
+}
+
+// retired assemblies can go once the change feed has moved past their last change; with "all", they all go
+void catalog_reclaim(int all){
+        assembly_t ** link = &catalog_reload.retired;
+        while (*link != NULL){
+                assembly_t * assembly = *link;
+                if (all || assembly->changed_seq < feed.first_seq){
+                        *link = assembly->next;
+                        assembly_free(assembly);
+                }
+                else{
+                        link = &assembly->next;
+                }
+        }
+}
+
+// a reload still being built when the requests end is published all the same, rather than dropped without a word
+void catalog_stop(){
+        catalog_poll(1);
+        catalog_reclaim(1);
+}
+
+// lookup functions
+part_t * lookup_part(part_t * pp, char * id){
+        part_t * pointer;
+        while (pp != NULL){
+                if (strcmp(pp->id, id) == 0){
+                        pointer = pp;
+                        return pointer;
+                }
+                pp = pp->next;
+        }
+        return NULL;
+}
+
+assembly_t * lookup_assembly(assembly_t * ap, char * id){
+        assembly_t * pointer;
+        while (ap != NULL){
+                if (strcmp(ap->id, id) == 0){
+                        pointer = ap;
+                        return pointer;
+                }
+                ap = ap->next;
+        }
+        return NULL;
+}
+
+item_t * lookup_item(item_t * ip, char * id){
+        item_t * pointer;
+        while (ip != NULL){
+                if (strcmp(ip->id, id) == 0){
+                        pointer = ip;
+                        return pointer;
+                }
+                ip = ip->next;
+        }
+        return NULL;
+}
+
+part_t * find_part(inventory_t * invp, char * id){
+        part_t * part = index_lookup(&invp->part_index, id);
+        PROBE2(lookup__part, id, part);
+        return part;
+}
+
+assembly_t * find_assembly(inventory_t * invp, char * id){
+        assembly_t * assembly = index_lookup(&invp->assembly_index, id);
+        PROBE2(lookup__assembly, id, assembly);
+        return assembly;
+}
+
+void count_tree_nodes(inventory_t * invp, assembly_t * assembly){
+        // its own make() plus one per sub-assembly line, all the way down; saturating, since shared sub-assemblies multiply
+        long long nodes = 1;
+        item_t * current_item = assembly->items->item_list;
+        while (current_item != NULL){
+                if (current_item->id[0] == 'A'){
+                        long long child = find_assembly(invp, current_item->id)->tree_nodes;
+                        nodes = child > LLONG_MAX - nodes ? LLONG_MAX : nodes + child;
+                }
+                current_item = current_item->next;
+        }
+        assembly->tree_nodes = nodes;
+}
+
+int part_table_reserve(inventory_t * invp, int count){
+        return grow_array(MEM_INDEX, (void **)&invp->part_table, &invp->part_table_capacity, count, sizeof(part_t *), 16);
+}
+
+int link_part(inventory_t * invp, part_t * part){
+        if (part_table_reserve(invp, invp->part_count + 1) != 0 || index_insert(&invp->part_index, part) != 0){
+                return -1;
+        }
+        part->index = invp->part_count;
+        invp->part_table[part->index] = part;
+
+        // appending at the tail
+        if (invp->part_list == NULL){
+                invp->part_list = part;
+        }
+        else {
+                invp->part_tail->next = part;
+        }
+        invp->part_tail = part;
+        invp->part_count++;
+        if (replication.role == REPLICATION_PRIMARY && invp == &inv){
+                journal_append(JOURNAL_PART, part->id, 0, NULL);
+        }
+        return 0;
+}
+
+int link_assembly(inventory_t * invp, assembly_t * assembly){
+        if (index_insert(&invp->assembly_index, assembly) != 0){
+                return -1;
+        }
+        assembly->index = invp->assembly_count;
+
+        // appending at the tail
+        if (invp->assembly_list == NULL){
+                invp->assembly_list = assembly;
+        }
+        else {
+                invp->assembly_tail->next = assembly;
+        }
+        invp->assembly_tail = assembly;
+        invp->assembly_count++;
+        if (replication.role == REPLICATION_PRIMARY && invp == &inv){
+                journal_append(JOURNAL_ASSEMBLY, assembly->id, assembly->capacity, assembly->items);
+        }
+        return 0;
+}
+
+// main function
+int main(int argc, char *argv[]){
+        // options start with "--"; anything else is the request file
+        char * filename = NULL;
+        int partition_count = 0;
+        enum replication_role role = REPLICATION_NONE;
+        char * socket_path = NULL;
+        char * capture_path = NULL;
+        char * replay_path = NULL;
+        for (int i = 1; i < argc; i++){
+                if (strncmp(argv[i], "--format=", 9) == 0){
+                        if (set_output_format(argv[i] + 9) != 0){
+                                fprintf(stderr, "!!! %s: unknown output format\n", argv[i] + 9);
+                                return EXIT_FAILURE;
+                        }
+                }
+                else if (strncmp(argv[i], "--partitions=", 13) == 0){
+                        char * end;
+                        partition_count = (int)strtol(argv[i] + 13, &end, 10);
+                        if (*end != '\0' || partition_count < 1 || partition_count > MAX_PARTITIONS){
+                                fprintf(stderr, "!!! %s: partitions must be 1 to %d\n", argv[i] + 13, MAX_PARTITIONS);
+                                return EXIT_FAILURE;
+                        }
+                }
+                else if (strncmp(argv[i], "--primary=", 10) == 0 || strncmp(argv[i], "--replica=", 10) == 0){
+                        if (role != REPLICATION_NONE){
+                                fprintf(stderr, "!!! %s: only one of --primary and --replica\n", argv[i]);
+                                return EXIT_FAILURE;
+                        }
+                        role = argv[i][2] == 'p' ? REPLICATION_PRIMARY : REPLICATION_REPLICA;
+                        socket_path = argv[i] + 10;
+                }
+                else if (strncmp(argv[i], "--capture=", 10) == 0){
+                        capture_path = argv[i] + 10;
+                }
+                else if (strncmp(argv[i], "--replay=", 9) == 0){
+                        replay_path = argv[i] + 9;
+                }
+                else if (strcmp(argv[i], "--paced") == 0){
+                        replay.paced = 1;
+                }
+                else if (strncmp(argv[i], "--", 2) == 0){
+                        fprintf(stderr, "!!! %s: unknown option\n", argv[i]);
+                        return EXIT_FAILURE;
+                }
+                else if (filename != NULL){
+                        // checking for correct command line size
+                        perror("Too many command-line arguments");
+                        return EXIT_FAILURE;
+                }
+                else{
+                        filename = argv[i];
+                }
+        }
+        if (role != REPLICATION_NONE && partition_count > 0){
+                fprintf(stderr, "!!! --partitions: not available with replication\n");
+                return EXIT_FAILURE;
+        }
+        if (replay_path != NULL && filename != NULL){
+                fprintf(stderr, "!!! --replay: the capture takes the place of a request file\n");
+                return EXIT_FAILURE;
+        }
+        if (replay.paced && replay_path == NULL){
+                fprintf(stderr, "!!! --paced: only with --replay\n");
+                return EXIT_FAILURE;
+        }
+        if (replay_path != NULL){
+                filename = replay_path;
+                replay.active = 1;
+        }
+
+        // file creation, and determining whether program is reading file or standard input
+        FILE *fp;
+
+        if (filename != NULL){
+                fp = fopen(filename, "r");
+                if(fp == NULL){
+                        perror("Failed to open file");
+                        return EXIT_FAILURE;
+                }
+        }
+        else{
+                fp = stdin;
+        }
+        catalog_reload.interactive = isatty(fileno(fp));
+
+        // with partitions this process coordinates, and each worker reads its requests from the coordinator instead
+        if (partition_count > 0){
+                fp = partition_start(partition_count, fp);
+                if (fp == NULL){
+                        return EXIT_FAILURE;
+                }
+        }
+
+        // a primary ships its journal and a replica applies one, each from threads of its own, while no request is being served
+        if (role != REPLICATION_NONE && replication_start(role, socket_path) != 0){
+                return EXIT_FAILURE;
+        }
+        replication_hold();
+
+        // a worker's requests come from the coordinator, which does any capturing or replaying
+        if (partitions.self >= 0){
+                replay.active = 0;
+        }
+        else if ((capture_path != NULL && capture_start(capture_path) != 0) || (replay.active && replay_start() != 0)){
+                return EXIT_FAILURE;
+        }
+
+        // requests are read ahead on a thread of their own, except in a worker, whose socket the partition code shares
+        struct input input;
+        input_open(&input, fp, partitions.self >= 0);
+
+        // a captured line is a request after its time
+        char line[MAX_LINE_LENGTH + CAPTURE_STAMP_MAX];
+        while (1){
+                // pushing the previous request's changes (and, in a worker, its answer) out before waiting on the next one
+                feed_flush();
+                partition_finish();
+                replay_finish();
+                replication_release();
+                if (input_gets(&input, line, replay.active ? (int)sizeof(line) : MAX_LINE_LENGTH) == NULL){
+                        break;
+                }
+                char * request = replay.active ? replay_next(line) : line;
+                if (request == NULL){
+                        continue;
+                }
+                replication_hold();
+
+                // a reloaded catalog takes over before a request, never partway through one: from a terminal, before the
+                // first request after it is built; otherwise before the request right after reloadCatalog, so the same
+                // request file always gives the same output
+                catalog_poll(!catalog_reload.interactive);
+
+                // handling in case there is an in-line comment
+                char * comment_pos = strchr(request, '#'); // finding index of comment
+                if (comment_pos != NULL){
+                    *comment_pos = '\0';
+                }
+                char * trimmed_line = trim(request);
+
+                // checking for empty lines or comment lines
+                if (strlen(trimmed_line) == 0){
+                        continue;
+                }
+                if (trimmed_line[0] == '#'){
+                        continue;
+                }
+
+                if (capture.fp != NULL){
+                        capture_request(trimmed_line);
+                }
+
+                // letting go of reservations that ran out while waiting for this request
+                wheel_advance();
+
+                // a worker's lines come from the coordinator: calls are answered right away, requests once they are served
+                if (partitions.self >= 0){
+                        if (strncmp(trimmed_line, "partition ", 10) == 0){
+                                partition_serve(trimmed_line + 10);
+                                continue;
+                        }
+                        partitions.replying = 1;
+                }
+                else{
+                        // echo back the request
+                        emit_request(trimmed_line);
+                }
+
+                // the coordinator passes requests on; whatever partition_route() leaves is served here as usual
+                if (partitions.count > 0 && partitions.self < 0 && partition_route(trimmed_line)){
+                        continue;
+                }
+                if (replica_refuses(trimmed_line)){
+                        continue;
+                }
+
+                // creating token to read requests
+                PROBE1(request, trimmed_line);
+                char * token;
+                token = strtok(trimmed_line, " ");
+
+                // requests that change the catalog wait for a reload in progress to be published first
+                if (catalog_reload.building && (strcmp(token, "addPart") == 0 || strcmp(token, "addAssembly") == 0 || strcmp(token, "importParts") == 0
+                    || strcmp(token, "importAssemblies") == 0 || strcmp(token, "clear") == 0 || strcmp(token, "reloadCatalog") == 0)){
+                        catalog_poll(1);
+                }
+
+                // checking for requests
+                if (strcmp(token, "quit") == 0){
+                        input_close(&input);
+                        quit();
+                }
+                else if (strcmp(token, "addPart") == 0){
+                        char * ID = strtok(NULL, " ");
+
+                        add_part(&inv, ID);
+                }
+                else if (strcmp(token, "addAssembly") == 0){
+                        // assists in checking invalid input
+                        int errorChecker = 1;
+
+                        char * ID = strtok(NULL, " ");
+                        if (ID == NULL){
+                                report_error("Invalid input");
+                                continue;
+                        }
+
+                        char * capacityString = strtok(NULL, " ");
+                        if (capacityString == NULL){
+                                report_error("Invalid input");
+                                continue;
+                        }
+                        long long capacity = atoll(capacityString);
+
+                        // creating items list
+                        items_needed_t * items = mem_alloc(MEM_ITEMS_NEEDED, sizeof(items_needed_t));
+                        if (items == NULL){
+                                report_error("Memory allocation failed");
+                                continue;
+                        }
+
+                        items->item_list = NULL;
+                        items->item_count = 0;
+                        items->spare = NULL;
+
+                        // keeping track of the last item added
+                        token = strtok(NULL, " ");
+                        while (token != NULL){
+                                char itemName[ID_MAX + 1];
+                                long long quantity;
+
+                                strcpy(itemName, token);
+                                token = strtok(NULL, " ");
+
+                                // checking for mismatched ITEM-ID pairing
+                                if (token == NULL){
+                                        errorChecker = -1;
+                                        report_error("Invalid input");
+                                        free_items(items);
+                                        break;
+                                }
+
+                                quantity = atoll(token);
+
+                                // remaining checks
+                                if (find_part(&inv, itemName) == NULL && find_assembly(&inv, itemName) == NULL){
+                                        report_error("%s: part/assembly ID is not in the inventory", itemName);
+                                        errorChecker = -1;
+                                        free_items(items);
+                                        break;
+                                }
+
+                                if (quantity <= 0){
+                                        report_error("%lld: illegal quantity for ID %s", quantity, itemName);
+                                        errorChecker = -1;
+                                        free_items(items);
+                                        break;
+                                }
+
+                                token = strtok(NULL, " ");
+
+                                // a repeated item adds up, and the total has to fit; add_item() reports a failed allocation itself
+                                if (add_item(items, itemName, quantity) != 0){
+                                        if (lookup_item(items->item_list, itemName) != NULL){
+                                                report_error("%lld: illegal quantity for ID %s", quantity, itemName);
+                                        }
+                                        errorChecker = -1;
+                                        free_items(items);
+                                        break;
+                                }
+                        }
+
+                        if (errorChecker == -1){
+                                continue;
+                        }
+
+                        add_assembly(&inv, ID, capacity, items);
+                }
+                else if (strcmp(token, "fulfillOrder") == 0){
+                        // a whole line always fits, so the order needs no allocation
+                        char order[MAX_LINE_LENGTH];
+                        memset(order, 0, sizeof(order));
+                        // getting the rest of the line into one string
+                        token = strtok(NULL, " ");
+                        while (token != NULL){
+                                strcat(order, token);
+                                strcat(order, " ");
+                                // printf("%s\n", token);
+                                token = strtok(NULL, " ");
+                        }
+                        // capping off the string
+                        strcat(order, "\0");
+
+                        fulfillOrder(order);
+                }
+                else if (strcmp(token, "stock") == 0){
+                        char * ID = strtok(NULL, " ");
+                        char * quantityString = strtok(NULL, " ");
+                        long long quantity = atoll(quantityString);
+                        stock(&inv, ID, quantity);
+                }
+                else if (strcmp(token, "restock") == 0){
+                        char * ID = strtok(NULL, " ");
+                        restock(&inv, ID);
+                }
+                else if (strcmp(token, "empty") == 0){
+                        char * ID = strtok(NULL, " ");
+                        empty(ID);
+                }
+                else if (strcmp(token, "inventory") == 0){
+                        char * ID = strtok(NULL, " ");
+                        if (ID != NULL && strcmp(ID, "--since") == 0){
+                                char * sinceString = strtok(NULL, " ");
+                                char * end;
+                                if (sinceString == NULL){
+                                        report_error("Invalid input");
+                                        continue;
+                                }
+                                long since = strtol(sinceString, &end, 10);
+                                if (end == sinceString || *end != '\0'){
+                                        report_error("%s: illegal change number", sinceString);
+                                        continue;
+                                }
+                                inventory_since(since);
+                        }
+                        else {
+                                inventory(ID);
+                        }
+                }
+                else if (strcmp(token, "subscribe") == 0){
+                        char * file = strtok(NULL, " ");
+                        char * option = strtok(NULL, " ");
+                        if (file == NULL || (option != NULL && strcmp(option, "low") != 0)){
+                                report_error("Invalid input");
+                                continue;
+                        }
+                        subscribe(file, option != NULL);
+                }
+                else if (strcmp(token, "unsubscribe") == 0){
+                        char * file = strtok(NULL, " ");
+                        if (file == NULL){
+                                report_error("Invalid input");
+                                continue;
+                        }
+                        unsubscribe(file);
+                }
+                else if (strcmp(token, "importParts") == 0){
+                        char * file = strtok(NULL, " ");
+                        if (file == NULL){
+                                report_error("Invalid input");
+                                continue;
+                        }
+                        import_parts(&inv, file);
+                }
+                else if (strcmp(token, "importAssemblies") == 0){
+                        char * file = strtok(NULL, " ");
+                        if (file == NULL){
+                                report_error("Invalid input");
+                                continue;
+                        }
+                        import_assemblies(&inv, file);
+                }
+                else if (strcmp(token, "reloadCatalog") == 0){
+                        char * file = strtok(NULL, " ");
+                        if (file == NULL){
+                                report_error("Invalid input");
+                                continue;
+                        }
+                        reload_catalog(file);
+                }
+                else if (strcmp(token, "parts") == 0){
+                        parts();
+                }
+                else if (strcmp(token, "memory") == 0){
+                        char * option = strtok(NULL, " ");
+                        if (option == NULL){
+                                memory();
+                        }
+                        else if (strcmp(option, "limit") == 0){
+                                char * limitString = strtok(NULL, " ");
+                                char * end;
+                                if (limitString == NULL){
+                                        report_error("Invalid input");
+                                        continue;
+                                }
+                                unsigned long long limit = strtoull(limitString, &end, 10);
+                                // optional K/M/G suffix
+                                if (*end == 'K' || *end == 'k'){
+                                        limit <<= 10;
+                                        end++;
+                                }
+                                else if (*end == 'M' || *end == 'm'){
+                                        limit <<= 20;
+                                        end++;
+                                }
+                                else if (*end == 'G' || *end == 'g'){
+                                        limit <<= 30;
+                                        end++;
+                                }
+                                if (limitString[0] == '-' || end == limitString || *end != '\0'){
+                                        report_error("%s: illegal memory limit", limitString);
+                                        continue;
+                                }
+                                memory_limit((size_t)limit);
+                        }
+                        else {
+                                report_error("Invalid input");
+                        }
+                }
+                else if (strcmp(token, "reserve") == 0){
+                        char * order = strtok(NULL, "");
+                        if (order == NULL){
+                                report_error("Invalid input");
+                                continue;
+                        }
+                        reserve(order);
+                }
+                else if (strcmp(token, "commit") == 0){
+                        char * rid = strtok(NULL, " ");
+                        if (rid == NULL){
+                                report_error("Invalid input");
+                                continue;
+                        }
+                        commit_reservation(rid);
+                }
+                else if (strcmp(token, "release") == 0){
+                        char * rid = strtok(NULL, " ");
+                        if (rid == NULL){
+                                report_error("Invalid input");
+                                continue;
+                        }
+                        release_reservation(rid);
+                }
+                else if (strcmp(token, "budget") == 0){
+                        char * budgetString = strtok(NULL, " ");
+                        char * end;
+                        if (budgetString == NULL){
+                                report_error("Invalid input");
+                                continue;
+                        }
+                        long long budget = strtoll(budgetString, &end, 10);
+                        if (budget < 0 || end == budgetString || *end != '\0'){
+                                report_error("%s: illegal parts budget", budgetString);
+                                continue;
+                        }
+                        parts_budget(budget);
+                }
+                else if (strcmp(token, "simulate") == 0){
+                        char * file = strtok(NULL, " ");
+                        if (file == NULL){
+                                report_error("Invalid input");
+                                continue;
+                        }
+                        simulate(&inv, file);
+                }
+                else if (strcmp(token, "trace") == 0){
+                        char * file = strtok(NULL, " ");
+                        if (file == NULL){
+                                report_error("Invalid input");
+                        }
+                        else if (strcmp(file, "off") == 0){
+                                trace_stop();
+                        }
+                        else{
+                                trace_start(file);
+                        }
+                }
+                else if (strcmp(token, "format") == 0){
+                        char * mode = strtok(NULL, " ");
+                        if (mode == NULL){
+                                report_error("Invalid input");
+                        }
+                        else if (set_output_format(mode) != 0){
+                                report_error("%s: unknown output format", mode);
+                        }
+                }
+                else if (strcmp(token, "makeReport") == 0){
+                        char * mode = strtok(NULL, " ");
+                        if (mode == NULL){
+                                report_error("Invalid input");
+                        }
+                        else if (set_make_report(mode) != 0){
+                                report_error("%s: unknown make report", mode);
+                        }
+                }
+                else if (strcmp(token, "help") == 0){
+                        help();
+                }
+                else if (strcmp(token, "clear") == 0){
+                        clear();
+                }
+                else {
+                    report_error("%s: unknown command", token);
+                }
+        }
+        replication_hold();
+        catalog_stop();
+        partition_stop();
+        replication_stop();
+        trace_stop();
+        clear();
+        undo_free(&order_undo);
+        workspace_free(&workspace);
+        parallel_restock_free();
+        record_free(&output_record);
+        input_close(&input);
+        capture_stop();
+        replay_stop();
+        return EXIT_SUCCESS;
+}
@@ -1,234 +1,1534 @@
-/*
- * @auther: Ryan Chen, rwc6613@rit.edu
- */
-
-#ifndef INVENTORY_H
-#define INVENTORY_H
-#include <stdlib.h>
-#include <stdio.h>
-#include <string.h>
-#include "trimit.h"
-
-extern char * trim(char *);
-extern int getline(char **, size_t *, FILE *);
-
-#define ID_MAX 11
-
-/*
- * Struct for a "part"
- * @param id - the id associated with a given part, used for identification
- * @param next - pointer to the next part added, in the form of a linked list
- */
-struct part {
-    char id[ID_MAX+1];        // ID_MAX plus NUL
-    struct part * next; // the next part in the list of parts
-};
-
-/*
- * Struct for an "assembly"
- * @param id - the id associated with a given assembly, used for identification
- * @param capacity - the maximum number of a given "assembly" can have on-hand
- * @param on_hand - the current amount of the given "assembly" that is available
- * @param items - the "recipe" for the assembly, consisting of "parts"/"assemblies" needed to make it
- * @param next - pointer to the next assembly, in the form of a linked list
- */
-struct assembly {
-    char id[ID_MAX+1];
-    int capacity;
-    int on_hand;
-    struct items_needed * items; // parts/sub-assemblies needed for this ID
-    struct assembly * next;      // the next assembly in the inventory list
-};
-
-/*
- * Struct for an "item", which can either be a "part" or an "assembly"
- * @param id - the id associated with a given item, used for identification
- * @param quantity - the amount of the item that is currently available and/or is needed
- * @param next - pointer to the next item, in the form of a linked list
- */
-struct item {
-    char id[ID_MAX+1];           // ID_MAX plus NUL
-    int quantity;
-    struct item * next; // next item in the part/assembly list
-};
-
-/*
- * Struct for an "inventory", which consists of a list of "parts" and "assemblies"
- * @param part_list - pointer to the first element of the list of parts
- * @param part_count - the amount of parts in the inventory
- * @param assembly_list - pointer to the first element of the list of assemblies
- * @param assembly_count - the amount of assemblies in the inventory
- */
-struct inventory {
-   struct part * part_list;         // list of parts by ID
-    int part_count;                  // number of distinct parts
-    struct assembly * assembly_list; // list of assemblies by ID
-    int assembly_count;              // number of distinct assemblies
-};
-
-/*
- * Struct of an "items_needed" list, which is a list of items needed to make a given "assembly"
- * @param item_list - pointer to the first element of the list of parts
- * @param item_count - the amount of items in "item_list"
- */
-struct items_needed {
-    struct item * item_list;
-    int item_count;
-};
-
-// NOTE: pre-provided "request" struct has been removed; not used
-
-// Type-defs for the various structs indicated above
-typedef struct inventory inventory_t;
-typedef struct items_needed items_needed_t;
-typedef struct item item_t;
-typedef struct part part_t;
-typedef struct assembly assembly_t;
-
-/*
- * FUNCTIONS TO BE IMPLEMENTED
- */
-
-/*
- * Looks up a part with the same ID as the given parameter "id"
- * @param pp - part pointer, points to a list of "parts"
- * @param id - a string ID that we want to lookup
- * @return - returns a pointer whose ID matches given parameter "id"
- *           if such a part doesn't exist, returns NULL
- */
-part_t * lookup_part(part_t * pp, char * id);
-
-/*
- * Looks up an assembly with the same ID as the given parameter "id"
- * @param ap - assembly pointer, points to a list of "assemblies"
- * @param id - a string ID that we want to lookup
- * @return - returns a pointer whose ID matches given parameter "id"
- *           if such an assembly doesn't exist, returns NULL
- */
-assembly_t * lookup_assembly(assembly_t * ap, char * id);
-
-/*
- * Looks up an item with the same ID as the given parameter "id"
- * @param ip - item pointer, points to a list of "items"
- * @param id - a string ID that we want to lookup
- * @return - returns a pointer whose ID matches given parameter "id"
- *           if such an item doesn't exist, returns NULL
- */
-item_t * lookup_item(item_t * ip, char * id);
-
-/*
- * Adds a part to the inventory's parts list
- * @param invp - inventory pointer to the inventory we want to add a part to
- * @param id - a string for the part's name
- */
-void add_part(inventory_t * invp, char * id);
-
-/*
- * Adds an assembly to the inventory's assembly list
- * @param invp - inventory pointer to the inventory we want to add an assembly to
- * @param id - a string for the assembly's name
- * @param capacity - an integer that determines how many of this assembly the inventory can hold
- * @param items - a list of the items needed to create the assembly
- */
-void add_assembly(inventory_t * invp,
-                  char * id,
-                  int capacity,
-                  items_needed_t * items);
-
-/*
- * Adds an item to the given items_needed list parameter "items"
- * @param items - the items_needed list to add an item to
- * @param id - a string for the item's name
- * @param quantity - the amount of the item that should be added to the items_needed list
- */
-void add_item(items_needed_t * items, char * id, int quantity);
-
-/*
- * FUNCTIONS FOR THE INDIVIDAUL REQUESTS
- */
-
-/*
- * Fulfills an order given by the user, and will make more items to fulfill the order if necessary
- * @param order - a string with the user's order request, in the form of [xi ni [xi2 ni2 ...]]
- */
-void fulfillOrder(char * order);
-
-/*
- * Stocks the inventory with an assembly with the given parameter "id" by the given paramenter amount "n"; will not stock more than the capacity of the assembly in the inventory
- * @param invp - inventory pointer to the inventory we want to stock to
- * @param id - a string for the assembly's name
- * @param n - the number of assemblies to add to the inventory
- */
-void stock(inventory_t * invp, char * id, int n);
-
-/*
- * Restocks either a certain assembly in the inventory, or all assemblies within the inventory
- * @param invp - inventory pointer to the inventory we want to restock
- * @param id - an "optional" parameter; if it is provided, restock the assembly with the given ID, if it is NOT provided, restock all assemblies within the inventory
- */
-void restock(inventory_t * invp, char * id);
-
-/*
- * Empties out an entire assembly from the inventory, setting its on_hand to 0
- * @param id - the ID of the assembly we want to empty out
- */
-void empty(char * id);
-
-/*
- * Displays the content of the inventory, along with their capacities and amount on hand. If an ID is provided, will instead display contents specifically about the provided parameter "id", along with the components needed to make the assembly with the provided ID
- * @param id - an "optional" parameter; if it is provided, provides specific information about an assembly with that ID, if it is NOT provided, instead displays all assemblies within the inventory
- */
-void inventory(char * id);
-
-/*
- * Displays all parts of the inventory
- */
-void parts();
-
-/*
- * Displays a list of all possible requests and commands
- */
-void help();
-
-/*
- * Completely clears out the inventory, individually clearing all parts, assemblies, and assembly "recipes", then setting part count and assembly count back to 0
- */
-void clear();
-
-/*
- * Calls clear() to clear all the inventory, then terminates the program
- */
-void quit();
-
-
-/*
- * THESE ARE USED FOR SORTING PURPOSES
- */
-part_t ** to_part_array(int count, part_t * part_list);
-assembly_t ** to_assembly_array(int count, assembly_t * assembly_list);
-item_t ** to_item_array(int count, item_t * item_list);
-int part_compare(const void *, const void *);
-int assembly_compare(const void *, const void *);
-int item_compare(const void *, const void *);
-
-/*
- * Responsible for making more copies of an assembly
- * @param invp - inventory pointer of the inventory we want to access
- * @param id - the ID of the assembly we want to make
- * @param n - the number of copies of the assembly we want to make
- * @param parts - an items_needed list of the parts we will need to make "n" copies of assembly "id"
- */
-void make(inventory_t * invp, char * id, int n, items_needed_t * parts);
-
-/*
- * Gets copies of assemblies that we need to fulfill orders; if there are already enough copies of the ordered assemblies in the inventory, will take from the inventory before making more
- * @param invp - inventory pointer of the inventory we want to access
- * @param id - the ID of the assembly we want to get
- * @param n - the number of copies of the assembly we want to get
- * @param parts - an items_needed list of the parts we will need for "n" copies of assembly "id"
- */
-void get(inventory_t * invp, char * id, int n, items_needed_t * parts);
-
-// Note: pre-provided "print" functions and "free_inventory()" function were removed; functionality was either directly implemented into other functions, or were renamed to something else
-
+/*
+ * @auther: Ryan Chen, rwc6613@rit.edu
+ */
+
+#ifndef INVENTORY_H
+#define INVENTORY_H
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/types.h>
+#include "trimit.h"
+
+extern char * trim(char *);
+extern int getline(char **, size_t *, FILE *);
+
+#define ID_MAX 11
+#define MAX_WORKERS 16 // most threads any parallel request will use
+
+/*
+ * Struct for a "part"
+ * @param id - the id associated with a given part, used for identification
+ * @param index - the part's position in the inventory's part table, used to index demand vectors
+ * @param next - pointer to the next part added, in the form of a linked list
+ */
+struct part {
+    char id[ID_MAX+1];        // ID_MAX plus NUL
+    int index;
+    struct part * next; // the next part in the list of parts
+};
+
+/*
+ * Struct for an "assembly"
+ * @param id - the id associated with a given assembly, used for identification
+ * @param capacity - the maximum number of a given "assembly" can have on-hand
+ * @param on_hand - the current amount of the given "assembly" that is available
+ * @param reserved - how much of "on_hand" is held by reservations; get() only takes what isn't
+ * @param items - the "recipe" for the assembly, consisting of "parts"/"assemblies" needed to make it
+ * @param changed_seq - the change feed sequence number of the last change to "on_hand", 0 if it never changed
+ * @param index - the order the assembly was added in, starting at 0
+ * @param unit - the recipe resolved for make(), built the first time the assembly is made
+ * @param tree_nodes - how many make() calls making this assembly takes when nothing below it is in stock
+ * @param visit_mark - used to visit each assembly once when searching the assembly graph
+ * @param partition - the partition holding this assembly's stock, see "THESE ARE USED FOR PARTITIONS"
+ * @param partition_local - 1 if every sub-assembly below this one is held by the same partition
+ * @param component - the next assembly towards the root of its component, see "THESE ARE USED FOR RESTOCKING IN PARALLEL"
+ * @param component_size - the number of assemblies in the component, kept up to date on the root only
+ * @param next - pointer to the next assembly, in the form of a linked list
+ */
+struct assembly {
+    char id[ID_MAX+1];
+    long long capacity;
+    long long on_hand;
+    long long reserved;
+    struct items_needed * items; // parts/sub-assemblies needed for this ID
+    long changed_seq;
+    int index;
+    struct unit_demand * unit;
+    long long tree_nodes;
+    unsigned visit_mark;
+    int partition;
+    int partition_local;
+    struct assembly * component;
+    int component_size;
+    struct assembly * next;      // the next assembly in the inventory list
+};
+
+/*
+ * Struct for an "item", which can either be a "part" or an "assembly"
+ * @param id - the id associated with a given item, used for identification
+ * @param quantity - the amount of the item that is currently available and/or is needed
+ * @param next - pointer to the next item, in the form of a linked list
+ */
+struct item {
+    char id[ID_MAX+1];           // ID_MAX plus NUL
+    long long quantity;
+    struct item * next; // next item in the part/assembly list
+};
+
+/*
+ * Struct for an "id_index", a hash table of parts or assemblies keyed by their ID
+ * @param slots - open-addressed table of pointers to parts/assemblies; both structs start with their ID, so a slot can be read as a string
+ * @param capacity - the number of slots, always zero or a power of two
+ * @param count - the number of occupied slots
+ */
+struct id_index {
+    void ** slots;
+    size_t capacity;
+    size_t count;
+};
+
+/*
+ * Struct for an "inventory", which consists of a list of "parts" and "assemblies"
+ * @param part_list - pointer to the first element of the list of parts
+ * @param part_tail - pointer to the last element of the list of parts, for appending
+ * @param part_count - the amount of parts in the inventory
+ * @param assembly_list - pointer to the first element of the list of assemblies
+ * @param assembly_tail - pointer to the last element of the list of assemblies, for appending
+ * @param assembly_count - the amount of assemblies in the inventory
+ * @param part_index - hash index of the parts by ID
+ * @param assembly_index - hash index of the assemblies by ID
+ * @param part_table - every part, by its "index"
+ * @param part_table_capacity - the number of entries "part_table" has room for
+ */
+struct inventory {
+   struct part * part_list;         // list of parts by ID
+    struct part * part_tail;
+    int part_count;                  // number of distinct parts
+    struct assembly * assembly_list; // list of assemblies by ID
+    struct assembly * assembly_tail;
+    int assembly_count;              // number of distinct assemblies
+    struct id_index part_index;
+    struct id_index assembly_index;
+    struct part ** part_table;
+    size_t part_table_capacity;
+};
+
+/*
+ * Struct of an "items_needed" list, which is a list of items needed to make a given "assembly"
+ * @param item_list - pointer to the first element of the list of parts
+ * @param item_count - the amount of items in "item_list"
+ * @param spare - items kept by items_clear() for add_item() to reuse
+ */
+struct items_needed {
+    struct item * item_list;
+    int item_count;
+    struct item * spare;
+};
+
+/*
+ * Struct of a "unit_demand", an assembly's recipe resolved for make(): what one unit needs directly
+ * @param part_index - the part index of each distinct part in the recipe
+ * @param part_quantity - how many of each of those parts one unit needs
+ * @param part_count - the number of entries in "part_index"/"part_quantity"
+ * @param max_quantity - the largest entry in "part_quantity", so one check covers every product for overflow
+ * @param dense - per-unit quantities for part indexes low..low+span-1 (zero where unused), or NULL to use the sparse form
+ * @param low - the part index "dense" starts at
+ * @param span - the number of entries in "dense"
+ * @param assemblies - the sub-assemblies in the recipe, in the order make() gets them
+ * @param assembly_quantity - how many of each sub-assembly one unit needs
+ * @param assembly_count - the number of entries in "assemblies"/"assembly_quantity"
+ */
+struct unit_demand {
+    int * part_index;
+    long long * part_quantity;
+    int part_count;
+    long long max_quantity;
+    long long * dense;
+    int low;
+    int span;
+    struct assembly ** assemblies;
+    long long * assembly_quantity;
+    int assembly_count;
+};
+
+/*
+ * Struct of a "demand" accumulator, the parts needed for a request, kept as a dense vector over the part table
+ * @param quantity - how many of each part are needed, by part index
+ * @param part_seen - 1 for each part index already in "touched"
+ * @param touched - the part indexes with a nonzero "quantity", in the order they were first needed
+ * @param touched_count - the number of entries in "touched"
+ * @param assembly_seen - 1 for each assembly index whose parts have been added at least once
+ * @param seen_assemblies - the assembly indexes set in "assembly_seen", so they can be cleared one by one
+ * @param seen_count - the number of entries in "seen_assemblies"
+ * @param part_count - the number of parts the accumulator was made for
+ * @param assembly_count - the number of assemblies the accumulator was made for
+ * @param overflow - set once any quantity overflowed; the request's parts list is then unusable
+ * @param fork - the fork whose on_hand counts make() and get() read and change, or NULL for the real inventory
+ * @param undo - the transaction the request's changes to the real inventory are logged in, or NULL to apply them directly
+ * @param threaded - set when the request is already planned on one of several threads, so make() doesn't start more
+ * @param made - how many units of each assembly make() made, by assembly index, when make lines aren't printed as they happen
+ * @param made_assemblies - the assemblies with a nonzero "made", in the order they were first made
+ * @param made_count - the number of entries in "made_assemblies"
+ */
+struct demand {
+    long long * quantity;
+    unsigned char * part_seen;
+    int * touched;
+    int touched_count;
+    unsigned char * assembly_seen;
+    int * seen_assemblies;
+    int seen_count;
+    int part_count;
+    int assembly_count;
+    int overflow;
+    struct inventory_fork * fork;
+    struct undo_log * undo;
+    int threaded;
+    long long * made;
+    struct assembly ** made_assemblies;
+    int made_count;
+};
+
+/*
+ * Struct for a "change", one entry in the change feed
+ * @param seq - the sequence number of the change; every change gets the next number
+ * @param assembly - the assembly whose on_hand changed
+ * @param old_on_hand - on_hand before the change
+ * @param new_on_hand - on_hand after the change
+ */
+struct change {
+    long seq;
+    struct assembly * assembly;
+    long long old_on_hand;
+    long long new_on_hand;
+};
+
+#define MAX_SUBSCRIBERS 8
+#define CHANGE_LOG_SIZE (1 << 16) // changes kept for "inventory --since", a power of two
+
+/*
+ * Struct for a "subscriber", a file that on_hand changes are pushed to
+ * @param filename - the name the subscription was made with, used to unsubscribe
+ * @param fp - the open file
+ * @param low_only - 1 to only push low-stock crossings, 0 to push every change
+ */
+struct subscriber {
+    char * filename;
+    FILE * fp;
+    int low_only;
+};
+
+/*
+ * Struct for the "change_feed", which records every change to an assembly's on_hand
+ * @param log - ring buffer of the most recent changes, indexed by seq % CHANGE_LOG_SIZE
+ * @param first_seq - the oldest sequence number still in the log
+ * @param last_seq - the newest sequence number handed out, 0 before the first change
+ * @param subscribers - files that changes are pushed to
+ * @param subscriber_count - the number of "subscribers"
+ */
+struct change_feed {
+    struct change * log;
+    long first_seq;
+    long last_seq;
+    struct subscriber subscribers[MAX_SUBSCRIBERS];
+    int subscriber_count;
+};
+
+// NOTE: pre-provided "request" struct has been removed; not used
+
+// Type-defs for the various structs indicated above
+typedef struct inventory inventory_t;
+typedef struct items_needed items_needed_t;
+typedef struct item item_t;
+typedef struct part part_t;
+typedef struct assembly assembly_t;
+typedef struct unit_demand unit_demand_t;
+typedef struct demand demand_t;
+
+/*
+ * Categories used for allocation accounting, one per kind of structure the inventory allocates
+ */
+enum mem_kind {
+    MEM_PART,         // part_t nodes
+    MEM_ASSEMBLY,     // assembly_t nodes
+    MEM_ITEMS_NEEDED, // items_needed_t headers
+    MEM_ITEM,         // item_t nodes
+    MEM_INDEX,        // id_index hash tables
+    MEM_FEED,         // change feed log
+    MEM_PLAN,         // unit_demand recipes resolved for make()
+    MEM_SCRATCH,      // temporary arrays/buffers used while serving a request
+    MEM_TRACE,        // trace event rings
+    MEM_RESERVATION,  // reservations and their lines
+    MEM_JOURNAL,      // the replication journal
+    MEM_INPUT,        // request input buffers
+    MEM_WORKSPACE,    // the planning workspace
+    MEM_KINDS         // number of categories, not a category itself
+};
+
+/*
+ * Struct of the allocation statistics kept for one "mem_kind"
+ * @param live_bytes - bytes requested by objects that are currently allocated
+ * @param live_count - number of objects that are currently allocated
+ * @param peak_bytes - the highest "live_bytes" has ever been
+ * @param overhead_bytes - malloc bookkeeping and rounding on top of "live_bytes"
+ */
+struct mem_stats {
+    size_t live_bytes;
+    size_t live_count;
+    size_t peak_bytes;
+    size_t overhead_bytes;
+};
+
+/*
+ * FUNCTIONS TO BE IMPLEMENTED
+ */
+
+/*
+ * Looks up a part with the same ID as the given parameter "id"
+ * @param pp - part pointer, points to a list of "parts"
+ * @param id - a string ID that we want to lookup
+ * @return - returns a pointer whose ID matches given parameter "id"
+ *           if such a part doesn't exist, returns NULL
+ */
+part_t * lookup_part(part_t * pp, char * id);
+
+/*
+ * Looks up an assembly with the same ID as the given parameter "id"
+ * @param ap - assembly pointer, points to a list of "assemblies"
+ * @param id - a string ID that we want to lookup
+ * @return - returns a pointer whose ID matches given parameter "id"
+ *           if such an assembly doesn't exist, returns NULL
+ */
+assembly_t * lookup_assembly(assembly_t * ap, char * id);
+
+/*
+ * Looks up an item with the same ID as the given parameter "id"
+ * @param ip - item pointer, points to a list of "items"
+ * @param id - a string ID that we want to lookup
+ * @return - returns a pointer whose ID matches given parameter "id"
+ *           if such an item doesn't exist, returns NULL
+ */
+item_t * lookup_item(item_t * ip, char * id);
+
+/*
+ * Looks up a part in the inventory's part index
+ * @param invp - inventory pointer to the inventory we want to search
+ * @param id - a string ID that we want to lookup
+ * @return - returns a pointer to the part whose ID matches, or NULL if there is none
+ */
+part_t * find_part(inventory_t * invp, char * id);
+
+/*
+ * Looks up an assembly in the inventory's assembly index
+ * @param invp - inventory pointer to the inventory we want to search
+ * @param id - a string ID that we want to lookup
+ * @return - returns a pointer to the assembly whose ID matches, or NULL if there is none
+ */
+assembly_t * find_assembly(inventory_t * invp, char * id);
+
+/*
+ * Adds a newly allocated part/assembly to the end of the inventory's list and to its index
+ * @param invp - inventory pointer to the inventory we want to add to
+ * @return - returns 0, or -1 if the index couldn't grow (the inventory is left unchanged)
+ */
+int link_part(inventory_t * invp, part_t * part);
+int link_assembly(inventory_t * invp, assembly_t * assembly);
+int part_table_reserve(inventory_t * invp, int count);
+void count_tree_nodes(inventory_t * invp, assembly_t * assembly);
+
+/*
+ * Adds a part to the inventory's parts list
+ * @param invp - inventory pointer to the inventory we want to add a part to
+ * @param id - a string for the part's name
+ */
+void add_part(inventory_t * invp, char * id);
+
+/*
+ * Adds an assembly to the inventory's assembly list
+ * @param invp - inventory pointer to the inventory we want to add an assembly to
+ * @param id - a string for the assembly's name
+ * @param capacity - an integer that determines how many of this assembly the inventory can hold
+ * @param items - a list of the items needed to create the assembly
+ */
+void add_assembly(inventory_t * invp,
+                  char * id,
+                  long long capacity,
+                  items_needed_t * items);
+
+/*
+ * Allocates and links a part/assembly whose ID, capacity and recipe have already been checked; the assembly takes "items"
+ * @return - the new part/assembly, or NULL if it couldn't be allocated (the inventory is left unchanged, "items" with the caller)
+ */
+part_t * part_create(inventory_t * invp, char * id);
+assembly_t * assembly_create(inventory_t * invp, char * id, long long capacity, items_needed_t * items);
+
+/*
+ * Adds an item to the given items_needed list parameter "items"
+ * @param items - the items_needed list to add an item to
+ * @param id - a string for the item's name
+ * @param quantity - the amount of the item that should be added to the items_needed list
+ * @return - returns 0, or -1 if the item's quantity would overflow or the item couldn't be allocated
+ */
+int add_item(items_needed_t * items, char * id, long long quantity);
+
+/*
+ * Frees an items_needed list, including every item in it
+ * @param items - the items_needed list to free; may be NULL
+ */
+void free_items(items_needed_t * items);
+
+/*
+ * Empties an items_needed list, keeping its items for add_item() to reuse
+ * @param items - the items_needed list to empty
+ */
+void items_clear(items_needed_t * items);
+
+/*
+ * FUNCTIONS FOR THE INDIVIDAUL REQUESTS
+ */
+
+/*
+ * Fulfills an order given by the user, and will make more items to fulfill the order if necessary
+ * @param order - a string with the user's order request, in the form of [xi ni [xi2 ni2 ...]]
+ */
+void fulfillOrder(char * order);
+
+/*
+ * Stocks the inventory with an assembly with the given parameter "id" by the given paramenter amount "n"; will not stock more than the capacity of the assembly in the inventory
+ * @param invp - inventory pointer to the inventory we want to stock to
+ * @param id - a string for the assembly's name
+ * @param n - the number of assemblies to add to the inventory
+ */
+void stock(inventory_t * invp, char * id, long long n);
+
+/*
+ * Restocks either a certain assembly in the inventory, or all assemblies within the inventory
+ * @param invp - inventory pointer to the inventory we want to restock
+ * @param id - an "optional" parameter; if it is provided, restock the assembly with the given ID, if it is NOT provided, restock all assemblies within the inventory
+ */
+void restock(inventory_t * invp, char * id);
+
+/*
+ * Empties out an entire assembly from the inventory, setting its on_hand to 0
+ * @param id - the ID of the assembly we want to empty out
+ */
+void empty(char * id);
+
+/*
+ * Displays the content of the inventory, along with their capacities and amount on hand. If an ID is provided, will instead display contents specifically about the provided parameter "id", along with the components needed to make the assembly with the provided ID
+ * @param id - an "optional" parameter; if it is provided, provides specific information about an assembly with that ID, if it is NOT provided, instead displays all assemblies within the inventory
+ */
+void inventory(char * id);
+
+/*
+ * Loads many parts at once from a file with one part ID per line; the whole file is rejected if any line is bad
+ * @param invp - inventory pointer to the inventory we want to add parts to
+ * @param filename - the file to read
+ */
+void import_parts(inventory_t * invp, char * filename);
+
+/*
+ * Loads many assemblies at once from a file with one "ID,capacity[,x1,n1[,x2,n2...]]" line per assembly;
+ * recipes may use assemblies defined on earlier lines. The whole file is rejected if any line is bad
+ * @param invp - inventory pointer to the inventory we want to add assemblies to
+ * @param filename - the file to read
+ */
+void import_assemblies(inventory_t * invp, char * filename);
+
+/*
+ * Displays only the assemblies whose on_hand changed after change number "since", followed by the current change number.
+ * If those changes are no longer in the change feed, displays the whole inventory instead
+ * @param since - the change number the caller has already seen, usually from a previous call
+ */
+void inventory_since(long since);
+
+/*
+ * Starts pushing on_hand changes to a file, one "seq ID old new" line per change,
+ * plus a "seq ID low"/"seq ID ok" line whenever an assembly crosses its restock threshold
+ * @param filename - the file (or FIFO) to append to
+ * @param low_only - 1 to only push the threshold crossings
+ */
+void subscribe(char * filename, int low_only);
+
+/*
+ * Stops pushing changes to a file given to subscribe()
+ * @param filename - the file to stop pushing to
+ */
+void unsubscribe(char * filename);
+
+/*
+ * Displays all parts of the inventory
+ */
+void parts();
+
+/*
+ * Displays a list of all possible requests and commands
+ */
+void help();
+
+/*
+ * Displays how much memory each kind of structure is using, along with the configured memory limit
+ */
+void memory();
+
+/*
+ * Sets the memory ceiling; once reached, addPart and addAssembly requests are refused
+ * @param limit - the maximum number of bytes the inventory may hold, or 0 for no limit
+ */
+void memory_limit(size_t limit);
+
+/*
+ * Switches how results are written to standard output, see "THESE ARE USED FOR STRUCTURED OUTPUT" below
+ * @param mode - "text" for the usual tables, "jsonl" for JSON Lines, or "binary" for length-prefixed records
+ * @return - returns 0, or -1 if "mode" isn't one of those
+ */
+int set_output_format(char * mode);
+
+/*
+ * Switches how the make() calls of fulfillOrder, stock and restock are reported
+ * @param mode - "each" for a line per make() call as it happens, "aggregate" for a line per assembly made with its
+ *               total units, or "summary" for one line with the units and assemblies made
+ * @return - returns 0, or -1 if "mode" isn't one of those
+ */
+int set_make_report(char * mode);
+
+/*
+ * Holds on-hand assemblies for an order without consuming them, until the reservation is committed or released, or
+ * "ttl" seconds pass. Nothing is made: the whole reservation is refused if any assembly doesn't have enough available
+ * @param order - "x1 n1 [x2 n2 ...] ttl", as given to the request
+ */
+void reserve(char * order);
+
+/*
+ * Consumes the assemblies a reservation holds, and ends the reservation
+ * @param rid - the reservation's ID, as displayed by reserve()
+ */
+void commit_reservation(char * rid);
+
+/*
+ * Ends a reservation, making the assemblies it held available again
+ * @param rid - the reservation's ID, as displayed by reserve()
+ */
+void release_reservation(char * rid);
+
+/*
+ * Sets the parts budget of an order; a fulfillOrder that would need more parts than this (all part quantities added up) is canceled
+ * @param budget - the most parts one order may need, or 0 for no budget
+ */
+void parts_budget(long long budget);
+
+/*
+ * Runs a batch of what-if scenarios, one per line of a file, each against its own copy-on-write fork of the
+ * on_hand counts, and displays the parts each one needs and the ending stock of the assemblies it touched.
+ * A scenario is fulfillOrder, stock, restock and empty requests separated by ';'. The real inventory is left alone
+ * @param invp - inventory pointer to the inventory the scenarios start from
+ * @param filename - the file of scenarios
+ */
+void simulate(inventory_t * invp, char * filename);
+
+/*
+ * Starts recording a begin and an end event for every make() and get() call, to be written out as
+ * Chrome trace-event JSON (chrome://tracing, Perfetto) by trace_stop()
+ * @param filename - the file to write the trace to
+ */
+void trace_start(char * filename);
+
+/*
+ * Writes out the events recorded since trace_start() and stops recording; does nothing if not tracing
+ */
+void trace_stop();
+
+/*
+ * Completely clears out the inventory, individually clearing all parts, assemblies, and assembly "recipes", then setting part count and assembly count back to 0
+ */
+void clear();
+void catalog_free(inventory_t * invp);
+void assembly_free(assembly_t * assembly);
+
+/*
+ * Starts building a new catalog from "filename", a file of addPart and addAssembly lines, to replace the current one
+ * once it is complete and free of errors; see "THESE ARE USED FOR CATALOG RELOADS"
+ * @param filename - the catalog file
+ */
+void reload_catalog(char * filename);
+
+/*
+ * Calls clear() to clear all the inventory, then terminates the program
+ */
+void quit();
+
+
+/*
+ * THESE ARE USED FOR SORTING PURPOSES
+ */
+part_t ** to_part_array(int count, part_t * part_list);
+assembly_t ** to_assembly_array(int count, assembly_t * assembly_list);
+item_t ** to_item_array(int count, item_t * item_list);
+int part_compare(const void *, const void *);
+int assembly_compare(const void *, const void *);
+int item_compare(const void *, const void *);
+
+/*
+ * Responsible for making more copies of an assembly
+ * @param invp - inventory pointer of the inventory we want to access
+ * @param assembly - the assembly we want to make
+ * @param n - the number of copies of the assembly we want to make
+ * @param parts - a demand accumulator of the parts we will need to make "n" copies of "assembly"
+ * @return - returns 0, or -1 if a quantity overflowed (and "parts->overflow" is set)
+ */
+int make(inventory_t * invp, assembly_t * assembly, long long n, demand_t * parts);
+
+/*
+ * Gets copies of assemblies that we need to fulfill orders; if there are already enough copies of the ordered assemblies in the inventory, will take from the inventory before making more
+ * @param invp - inventory pointer of the inventory we want to access
+ * @param assembly - the assembly we want to get
+ * @param n - the number of copies of the assembly we want to get
+ * @param parts - a demand accumulator of the parts we will need for "n" copies of "assembly"
+ * @return - returns 0, or -1 if a quantity overflowed (and "parts->overflow" is set)
+ */
+int get(inventory_t * invp, assembly_t * assembly, long long n, demand_t * parts);
+
+/*
+ * THESE ARE USED FOR DEMAND VECTORS
+ * demand_scale_add() is the hot loop; it uses AVX2 when the CPU has it and a scalar loop otherwise
+ */
+int mul_overflows(long long a, long long b, long long * product);
+unit_demand_t * unit_demand_build(inventory_t * invp, assembly_t * assembly);
+void unit_demand_free(unit_demand_t * unit, int item_count);
+demand_t * demand_create(inventory_t * invp);
+void demand_free(demand_t * parts);
+int demand_add_unit(demand_t * parts, assembly_t * assembly, long long n);
+int demand_scale_add(long long * accumulator, const long long * vector, long long n, int count);
+int demand_scale_add_scalar(long long * accumulator, const long long * vector, long long n, int count);
+int demand_scale_add_avx2(long long * accumulator, const long long * vector, long long n, int count);
+void print_parts_needed(inventory_t * invp, demand_t * parts);
+void print_made(demand_t * parts);
+int demand_merge(demand_t * parts, demand_t * other);
+int demand_add_quantity(demand_t * parts, int index, long long quantity);
+void demand_add_made(demand_t * parts, assembly_t * assembly, long long n);
+
+/*
+ * THESE ARE USED FOR THE PLANNING WORKSPACE
+ * The main thread plans every request in one workspace that is reset between requests rather than freed, so once
+ * the inventory and the largest request have been seen, fulfillOrder, stock, restock, inventory and parts allocate
+ * nothing (tests/steady_alloc.sh checks this). Threads that plan in parallel keep their own demand vectors, and a
+ * request planned while the workspace is in use (a call from another partition) gets a demand vector of its own
+ * @param parts - the parts needed vector, sized for "part_capacity" parts and "assembly_capacity" assemblies
+ * @param parts_busy - set while "parts" is handed out
+ * @param sort - room for "sort_capacity" pointers, for sorting and for walking the assembly list backwards
+ * @param order - the items of the order being planned
+ */
+struct workspace {
+    demand_t parts;
+    int parts_busy;
+    int part_capacity;
+    int assembly_capacity;
+    void ** sort;
+    size_t sort_capacity;
+    items_needed_t order;
+};
+
+demand_t * workspace_demand(struct workspace * ws, inventory_t * invp);
+void workspace_release(struct workspace * ws, demand_t * parts);
+void workspace_demand_free(struct workspace * ws);
+void ** workspace_sort(struct workspace * ws, size_t count);
+items_needed_t * workspace_order(struct workspace * ws);
+void workspace_free(struct workspace * ws);
+
+/*
+ * THESE ARE USED FOR STRUCTURED OUTPUT
+ * Every result goes through an emit_*() function (or report_error()), which prints the usual text in "text" mode
+ * and one record per result otherwise. A jsonl record is a JSON object with a "type" key, on its own line. A binary
+ * record is a 4-byte length, then that many bytes: a record_type byte and the fields in the order they are listed
+ * below. Numbers are 8-byte integers, flags are 1 byte, strings are a 2-byte length and the bytes, and lists are a
+ * 4-byte count followed by each entry's fields. All integers are in the machine's byte order
+ */
+enum output_format {
+    FORMAT_TEXT,   // the human-readable tables
+    FORMAT_JSONL,  // JSON Lines
+    FORMAT_BINARY  // length-prefixed binary records
+};
+
+// how the make() calls of a request are reported
+enum make_report {
+    MAKE_REPORT_EACH,      // a make record for every make() call, as it happens
+    MAKE_REPORT_AGGREGATE, // one make record for each assembly made, with its total, before the parts needed
+    MAKE_REPORT_SUMMARY    // one make_summary record, before the parts needed
+};
+
+enum record_type {
+    RECORD_REQUEST = 1,   // line: the request as read
+    RECORD_ERROR,         // message
+    RECORD_MAKE,          // assembly, quantity
+    RECORD_RESTOCK,       // assembly, quantity
+    RECORD_PARTS_NEEDED,  // parts: list of (part, quantity)
+    RECORD_INVENTORY,     // assembly, capacity, on_hand, low (flag), reserved, available
+    RECORD_ASSEMBLY,      // assembly, capacity, on_hand, reserved, available, items: list of (item, quantity)
+    RECORD_CHANGE_SEQUENCE, // seq
+    RECORD_PART,          // part
+    RECORD_IMPORTED,      // file, kind ("parts" or "assemblies"), count
+    RECORD_MEMORY,        // structure, objects, live_bytes, peak_bytes
+    RECORD_MEMORY_LIMIT,  // limit, 0 for none
+    RECORD_HELP,          // request
+    RECORD_SCENARIO,      // scenario (numbered from 1), line; followed by its error, or its parts_needed and inventory records
+    RECORD_RESERVATION,   // reservation ("R" and a number), state ("reserved", "committed", "released" or "expired"), ttl (seconds, 0 unless reserved)
+    RECORD_MAKE_SUMMARY,  // units, assemblies
+    RECORD_RELOADED,      // file, parts, assemblies
+    RECORD_TYPES          // one past the last type, not a type itself
+};
+
+/*
+ * Struct of one record being built, reused from record to record so steady output doesn't allocate
+ * @param data - the record's bytes so far (or its text, in "text" mode)
+ * @param length - bytes used in "data"
+ * @param capacity - bytes allocated for "data"
+ * @param list_start - where the open list's count goes (binary)
+ * @param list_count - entries in the open list so far
+ * @param separate - 1 if the next JSON field needs a comma in front of it
+ * @param failed - set if an allocation failed, so the record is dropped rather than written out half-built
+ */
+struct record {
+    char * data;
+    size_t length;
+    size_t capacity;
+    size_t list_start;
+    unsigned list_count;
+    int separate;
+    int failed;
+};
+
+int record_reserve(struct record * record, size_t extra);
+void record_bytes(struct record * record, const void * bytes, size_t length);
+void record_key(struct record * record, const char * key);
+void record_quoted(struct record * record, const char * value);
+void record_begin(struct record * record, enum record_type type);
+void record_string(struct record * record, const char * key, const char * value);
+void record_number(struct record * record, const char * key, long long value);
+void record_flag(struct record * record, const char * key, int value);
+void record_list_begin(struct record * record, const char * key);
+void record_item_begin(struct record * record);
+void record_item_end(struct record * record);
+void record_list_end(struct record * record);
+void record_end(struct record * record);
+void record_text(struct record * record, const char * format, ...);
+void record_write(struct record * record);
+void record_free(struct record * record);
+void report_error(const char * format, ...);
+void emit_text(const char * format, ...);
+void emit_request(char * line);
+void format_make(struct record * record, assembly_t * assembly, long long n);
+void emit_make(assembly_t * assembly, long long n);
+void emit_make_summary(long long units, int assemblies);
+void format_restock(struct record * record, char * id, long long n);
+void emit_restock(char * id, long long n);
+void emit_inventory_header();
+void emit_inventory_row(assembly_t * assembly, long long on_hand);
+void emit_reservation(long id, char * state, long long ttl);
+void emit_scenario(int number, char * text);
+void emit_assembly(assembly_t * assembly, item_t ** item_array, int item_count);
+void emit_change_sequence(long seq);
+void emit_part(char * id);
+void emit_imported(char * filename, char * kind, int count);
+void emit_reloaded(char * filename, int part_count, int assembly_count);
+void emit_memory_row(const char * name, size_t objects, size_t live_bytes, size_t peak_bytes);
+void emit_help(char * request);
+
+/*
+ * THESE ARE USED FOR PARALLEL EXPLOSION
+ * make() hands an explosion to make_parallel() when it is big and nothing below it is in stock, so on_hand
+ * can't change along the way. Workers share out tasks by work stealing, each keeping its own demand accumulator,
+ * and each task keeps its own make lines so they can be printed in the usual order afterwards
+ */
+
+// a run of a task's output: text, then optionally everything a spawned sub-task printed
+struct explode_segment {
+    char * text;
+    size_t length;
+    size_t capacity;
+    struct explode_task * child;
+    struct explode_segment * next;
+};
+
+// making "n" units of "assembly"
+struct explode_task {
+    struct assembly * assembly;
+    long long n;
+    struct explode_segment * first;
+    struct explode_segment * last;
+    int depth; // make()/get() nesting it was spawned at, for the trace
+};
+
+// one thread, with its deque of tasks (owner pops the bottom, thieves take the top) and its own accumulator
+struct explode_worker {
+    struct explode * shared;
+    int id;
+    pthread_mutex_t lock;
+    struct explode_task ** tasks;
+    int top, bottom, capacity;
+    demand_t * parts;
+    struct record record; // for formatting make events
+};
+
+struct explode {
+    struct explode_worker workers[MAX_WORKERS];
+    int worker_count;
+    long pending; // tasks spawned but not finished
+    int failed;
+    struct explode_task * root; // traced by make() rather than by whichever worker expands it
+};
+
+int subtree_unstocked(inventory_t * invp, assembly_t * assembly, unsigned mark);
+int make_parallel(inventory_t * invp, assembly_t * assembly, long long n, demand_t * parts, int worker_count);
+int explode_append(struct explode_task * task, const char * text, size_t length);
+struct explode_task * explode_task_create(assembly_t * assembly, long long n);
+void explode_task_free(struct explode_task * task);
+int explode_push(struct explode_worker * worker, struct explode_task * task);
+struct explode_task * explode_pop(struct explode_worker * worker);
+struct explode_task * explode_steal(struct explode_worker * worker);
+int explode_expand(struct explode_worker * worker, struct explode_task * task, assembly_t * assembly, long long n);
+int explode_expand_units(struct explode_worker * worker, struct explode_task * task, assembly_t * assembly, long long n);
+void * explode_work(void * arg);
+void explode_emit(struct explode_task * task, int print, struct record * held);
+
+/*
+ * THESE ARE USED FOR TRACING
+ * Each thread records into its own ring of events, so workers never wait on each other; when a ring wraps,
+ * its oldest events are dropped. All the checks in make()/get() are on "tracing", so it costs a branch when off
+ */
+#define TRACE_RING_SIZE (1 << 16) // events kept per thread, a power of two
+
+enum trace_kind {
+    TRACE_MAKE,
+    TRACE_GET
+};
+
+/*
+ * Struct of one begin ('B') or end ('E') event
+ * @param timestamp - nanoseconds since trace_start()
+ * @param requested - units asked for
+ * @param netted - units left to make after taking what was on hand
+ * @param depth - make()/get() calls this one is nested in
+ */
+struct trace_event {
+    long long timestamp;
+    long long requested;
+    long long netted;
+    char id[ID_MAX+1];
+    char phase;
+    char kind;
+    int depth;
+};
+
+/*
+ * Struct of one thread's ring of events
+ * @param events - TRACE_RING_SIZE events; the last "written" of them (at most) are valid
+ * @param written - events ever recorded in this ring
+ * @param thread - the thread's number in the exported trace, 0 for the main thread
+ * @param depth - current make()/get() nesting of the thread
+ * @param idle - 1 once the thread has exited, so the next new thread can carry on in this buffer
+ */
+struct trace_buffer {
+    struct trace_event * events;
+    unsigned long written;
+    int thread;
+    int depth;
+    int idle;
+    struct trace_buffer * next;
+};
+
+/*
+ * Struct of the tracing state
+ * @param fp - where trace_stop() writes the trace
+ * @param start - when trace_start() was called
+ * @param key - each thread's own trace_buffer
+ * @param buffers - every thread's buffer, including threads that have since exited
+ * @param lost - events not recorded because a buffer couldn't be allocated
+ */
+struct tracer {
+    FILE * fp;
+    char * filename;
+    struct timespec start;
+    pthread_key_t key;
+    int key_ready;
+    pthread_mutex_t lock;
+    struct trace_buffer * buffers;
+    int thread_count;
+    unsigned long lost;
+};
+
+struct trace_buffer * trace_buffer();
+void trace_release(void * buffer);
+void trace_event(char phase, enum trace_kind kind, assembly_t * assembly, long long requested, long long netted);
+int trace_depth();
+void trace_set_depth(int depth);
+void trace_print_id(FILE * fp, const char * prefix, const char * id);
+void trace_export(FILE * fp);
+int make_units(inventory_t * invp, assembly_t * assembly, long long n, demand_t * parts);
+
+/*
+ * THESE ARE USED FOR ORDER TRANSACTIONS
+ * While an order runs, get() applies its on_hand changes directly but logs each one, and its make events are held back.
+ * undo_commit() then publishes the changes to the change feed in order and lets the output out; undo_rollback()
+ * puts every on_hand back, newest first, and drops the output
+ */
+
+// one logged on_hand change
+struct undo_entry {
+    assembly_t * assembly;
+    long long old_on_hand;
+    long long new_on_hand;
+};
+
+/*
+ * Struct of an order's undo log, kept between orders so it only allocates when an order is bigger than any before
+ * @param entries - the changes, oldest first
+ * @param count - the number of changes logged
+ * @param capacity - the number of entries allocated
+ * @param held - output held until the order commits
+ * @param line - room for formatting one line of output before it is held
+ * @param failed - set if an entry couldn't be logged; the order must then roll back
+ */
+struct undo_log {
+    struct undo_entry * entries;
+    int count;
+    size_t capacity;
+    struct record held;
+    struct record line;
+    int failed;
+};
+
+void undo_begin(struct undo_log * undo);
+int undo_record(struct undo_log * undo, assembly_t * assembly, long long on_hand);
+void undo_commit(struct undo_log * undo);
+void undo_rollback(struct undo_log * undo);
+void undo_free(struct undo_log * undo);
+long long demand_total(demand_t * parts);
+
+/*
+ * THESE ARE USED FOR RESTOCKING IN PARALLEL
+ * Assemblies that share a sub-assembly, directly or further down, are in the same component of the assembly graph;
+ * the components are kept as a union-find forest that addAssembly joins as recipes link them. Restocking one
+ * component never changes what restocking another does, so restock of every assembly can hand the components out to
+ * lanes, one thread each. A lane restocks its assemblies in the usual LIFO order, into its own parts needed list,
+ * holding its changes to on_hand and its output in an undo log; the main thread then replays the lanes in the order
+ * one thread would have gone, so the output and the change feed are the same as ever
+ */
+
+/*
+ * Struct for a "restock step", where a lane was after one assembly of the restock
+ * @param lane - the lane restocking the assembly
+ * @param held - how much output the lane held after it
+ * @param changes - how many changes the lane logged after it
+ */
+struct restock_step {
+    struct restock_lane * lane;
+    size_t held;
+    int changes;
+};
+
+/*
+ * Struct for a "restock lane", one thread's share of a restock
+ * @param workspace - where the lane's parts needed list comes from, kept between restocks
+ * @param parts - the lane's parts needed list
+ * @param undo - the lane's changes and output, until they are replayed
+ * @param load - the number of assemblies in the components handed to the lane
+ * @param replayed_held - how much of the held output has been replayed
+ * @param replayed_changes - how many of the logged changes have been replayed
+ * @param failed - set if the lane couldn't finish; the restock is then rolled back and done on one thread
+ */
+struct restock_lane {
+    struct workspace workspace;
+    demand_t * parts;
+    struct undo_log undo;
+    long long load;
+    size_t replayed_held;
+    int replayed_changes;
+    int failed;
+};
+
+/*
+ * Struct of a restock spread across lanes
+ * @param invp - the inventory being restocked
+ * @param assemblies - every assembly, in the order they were added
+ * @param count - the number of "assemblies"
+ * @param steps - one for each assembly, by index
+ * @param step_capacity - the number of steps allocated, kept between restocks
+ * @param lanes - the lanes
+ */
+struct parallel_restock {
+    inventory_t * invp;
+    assembly_t ** assemblies;
+    int count;
+    struct restock_step * steps;
+    int step_capacity;
+    struct restock_lane lanes[MAX_WORKERS];
+};
+
+assembly_t * component_of(assembly_t * assembly);
+void join_components(inventory_t * invp, assembly_t * assembly);
+int restock_parallel(inventory_t * invp, assembly_t ** assemblies, int count, demand_t * parts);
+void * restock_lane_work(void * arg);
+void parallel_restock_free(void);
+
+/*
+ * THESE ARE USED FOR RESERVATIONS
+ * Expiry is a hierarchical timing wheel: WHEEL_LEVELS levels of WHEEL_SLOTS slots, a slot on level k spanning
+ * WHEEL_SLOTS^k one-second ticks. A reservation is filed on the lowest level whose span reaches its expiry, and moves
+ * down a level each time the level below wraps around, so each one is touched a few times at most and no tick
+ * scans more than the slots that are due
+ */
+#define WHEEL_LEVELS 4
+#define WHEEL_SLOTS 64       // a power of two
+#define WHEEL_SLOT_BITS 6    // log2(WHEEL_SLOTS)
+#define RESERVATION_TTL_MAX ((1LL << (WHEEL_LEVELS * WHEEL_SLOT_BITS)) - 1) // longest ttl the wheel can hold, in seconds
+
+// one assembly a reservation holds
+struct reservation_line {
+    assembly_t * assembly;
+    long long quantity;
+};
+
+/*
+ * Struct of a "reservation"
+ * @param id - the number in the reservation's ID ("R" followed by the number)
+ * @param lines - the assemblies held, one line per assembly
+ * @param expires - the wheel tick the reservation expires at
+ * @param level - the wheel level the reservation is filed on
+ * @param slot - the slot on that level
+ * @param prev - the previous reservation in the same wheel slot, so commits and releases unlink in O(1)
+ * @param next - the next reservation in the same wheel slot
+ * @param hash_next - the next reservation in the same bucket of the ID table
+ */
+struct reservation {
+    long id;
+    struct reservation_line * lines;
+    int line_count;
+    unsigned long expires;
+    int level, slot;
+    struct reservation * prev;
+    struct reservation * next;
+    struct reservation * hash_next;
+};
+
+/*
+ * Struct of all outstanding reservations
+ * @param slots - the timing wheel
+ * @param now - the current tick, in seconds since "start"
+ * @param buckets - the reservations by ID, chained
+ * @param bucket_count - the number of buckets, a power of two
+ */
+struct reservations {
+    struct reservation * slots[WHEEL_LEVELS][WHEEL_SLOTS];
+    unsigned long now;
+    struct timespec start;
+    int started;
+    struct reservation ** buckets;
+    size_t bucket_count;
+    size_t count;
+    long next_id;
+};
+
+long long available_of(demand_t * parts, assembly_t * assembly);
+void wheel_insert(struct reservation * reservation);
+void wheel_remove(struct reservation * reservation);
+void wheel_advance();
+struct reservation * reservation_find(char * rid);
+int reservation_link(struct reservation * reservation);
+void reservation_unlink(struct reservation * reservation);
+void reservation_end(struct reservation * reservation, char * state, int consume);
+void reservations_clear();
+
+/*
+ * THESE ARE USED FOR SIMULATION
+ * A fork shares the catalog and recipes with the real inventory and keeps only the on_hand counts it has changed.
+ * make() and get() go through on_hand_of()/change_on_hand(), which use the request's fork if it has one
+ */
+#define SIMULATE_BATCH 256 // scenarios run (and held in memory) at a time
+
+/*
+ * Struct of a copy-on-write fork of the on_hand counts, an open-addressing table keyed by assembly
+ * @param assemblies - the assembly in each slot, NULL for an empty slot
+ * @param on_hand - the fork's on_hand for the assembly in the same slot
+ * @param capacity - the number of slots, a power of two
+ * @param count - the number of assemblies the fork has changed
+ * @param failed - set if the table couldn't grow, so a change was lost
+ */
+struct inventory_fork {
+    assembly_t ** assemblies;
+    long long * on_hand;
+    size_t capacity;
+    size_t count;
+    int failed;
+};
+
+// one line of a "simulate" file, and what became of it
+struct scenario {
+    char * text;
+    demand_t * parts;
+    struct inventory_fork fork;
+    char error[128]; // empty unless the scenario was stopped
+};
+
+// one batch of scenarios; threads claim them with "next"
+struct simulation {
+    inventory_t * invp;
+    struct scenario * scenarios;
+    int next, end;
+    assembly_t ** assembly_array; // the assemblies in list order, for "restock"
+};
+
+long long on_hand_of(demand_t * parts, assembly_t * assembly);
+int change_on_hand(demand_t * parts, assembly_t * assembly, long long on_hand);
+size_t fork_slot(struct inventory_fork * fork, assembly_t * assembly);
+int fork_set_on_hand(struct inventory_fork * fork, assembly_t * assembly, long long on_hand);
+void fork_free(struct inventory_fork * fork);
+void simulate_scenario(struct simulation * simulation, struct scenario * scenario);
+int simulate_command(struct simulation * simulation, struct scenario * scenario, char * command);
+void * simulate_work(void * arg);
+void simulate_report(inventory_t * invp, struct scenario * scenario, int number);
+
+/*
+ * THESE ARE USED FOR PARTITIONS
+ * With "--partitions=N" the process forks N workers and becomes their coordinator. Every process keeps the whole
+ * catalog, but an assembly's stock is only kept, and the assembly only made, by the worker its "partition" names.
+ * get() on an assembly held somewhere else becomes a call to its owner, passed along by the coordinator; a call and
+ * the calls it leads to finish before anything else is read, so requests never interleave. An order whose lines all
+ * stay inside their own partitions is sent out at once, and the workers run their lines side by side.
+ * Messages are lines on one socket pair per worker, some followed by a payload:
+ *   coordinator to worker - a request line, "partition get ID N TXN", "partition restock ID", "partition stock",
+ *                           "partition commit", "partition abort"
+ *   worker to coordinator - "call ID N TXN" for a get() of its own
+ *   answers, either way   - "output LENGTH" or "error LENGTH" and that many bytes of standard output/error,
+ *                           "parts COUNT" and COUNT lines of "PART QUANTITY", "stock COUNT" and COUNT lines of
+ *                           "ASSEMBLY ON_HAND", then "done STATUS OVERFLOW"
+ */
+#define MAX_PARTITIONS 64
+#define PARTITION_COORDINATOR -1 // as a source: the coordinator; as a destination: the request being served here
+#define PARTITION_DISCARD -2     // answers nobody needs, to requests every worker repeats
+
+/*
+ * Struct of the coordinator's end of one worker's socket
+ * @param pid - the worker process
+ * @param in - answers and calls from the worker
+ * @param out - requests, calls and answers to the worker
+ * @param open - set once the worker has done part of the current order, so it is told how the order ends
+ */
+struct partition_channel {
+    pid_t pid;
+    FILE * in;
+    FILE * out;
+    int open;
+};
+
+/*
+ * Struct of the partitions
+ * @param count - the number of workers, 0 without partitions
+ * @param self - a worker's partition; -1 in the coordinator, or without partitions
+ * @param channels - the coordinator's end of each worker's socket
+ * @param in - a worker's end of its socket, for reading
+ * @param out - a worker's end of its socket, for writing
+ * @param replying - set while a worker serves a request line; it answers once the line is done
+ * @param open - set while a worker holds on_hand changes of an order in "order_undo"
+ * @param pending - set in the coordinator while the answers to a request every worker repeats are still to be read
+ */
+struct partitions {
+    int count;
+    int self;
+    struct partition_channel channels[MAX_PARTITIONS];
+    FILE * in;
+    FILE * out;
+    int replying;
+    int open;
+    int pending;
+};
+
+// how far a worker's output had got when it began serving a call, so the answer carries only what came after
+struct partition_mark {
+    off_t out;
+    off_t err;
+    size_t held;
+};
+
+FILE * partition_start(int count, FILE * fp);
+FILE * partition_worker(int self, int fd, FILE * fp);
+void partition_stop();
+void place_assembly(inventory_t * invp, assembly_t * assembly);
+int partition_route(char * line);
+void partition_broadcast(char * line);
+void partition_refresh();
+void partition_restock_all(inventory_t * invp);
+int partition_scatter(items_needed_t * items, demand_t * parts);
+int partition_get(assembly_t * assembly, long long n, demand_t * parts);
+void partition_settle(int commit);
+int partition_relay(int from, int to, demand_t * parts);
+char * partition_payload(FILE * in, size_t length);
+void partition_serve(char * message);
+void partition_mark(struct partition_mark * mark);
+void partition_ship(int fd, char * kind, off_t from);
+void partition_answer(struct partition_mark * mark, demand_t * parts, int status);
+void partition_finish();
+
+/*
+ * THESE ARE USED FOR REPLICATION
+ * A primary ("--primary=SOCKET") journals every change it applies: parts and assemblies as they are added, on_hand
+ * counts as set_on_hand() sets them (so an order only shows up once it has committed), and clears. A thread per
+ * replica ships the journal over a Unix socket between requests, with a tick every REPLICA_TICK seconds when there is
+ * nothing to ship. A replica ("--replica=SOCKET") applies what it is sent from a thread of its own and only answers
+ * questions, refusing them once it has heard nothing for REPLICA_MAX_LAG seconds.
+ * Requests and the journal never overlap: each process's main thread holds "lock" while it serves a request.
+ * On connecting, a replica sends "resume EPOCH SEQ" with the last entry it applied. If the journal still has
+ * everything after that, the primary answers "resume SEQ" and ships the tail; otherwise it sends "snapshot EPOCH SEQ",
+ * its whole inventory as entries, and "end", and goes on from there. Entries are lines: "part ID",
+ * "assembly ID CAPACITY [ID QUANTITY ...]", "onhand ID N", "clear", and "tick SEQ"
+ */
+#define JOURNAL_SIZE (1 << 16) // entries kept for replicas that reconnect, a power of two
+#define REPLICA_TICK 1         // seconds
+#define REPLICA_MAX_LAG 5      // seconds
+#define JOURNAL_BATCH 4096     // entries shipped per write, so the lock is never held for long
+
+enum replication_role {
+    REPLICATION_NONE,
+    REPLICATION_PRIMARY,
+    REPLICATION_REPLICA
+};
+
+enum journal_kind {
+    JOURNAL_PART,
+    JOURNAL_ASSEMBLY,
+    JOURNAL_ON_HAND,
+    JOURNAL_CLEAR
+};
+
+/*
+ * Struct of one journal entry
+ * @param id - the part or assembly
+ * @param value - the new on_hand for JOURNAL_ON_HAND, the capacity for JOURNAL_ASSEMBLY
+ * @param recipe - " ID QUANTITY" for each item of a JOURNAL_ASSEMBLY, NULL otherwise
+ */
+struct journal_entry {
+    enum journal_kind kind;
+    char id[ID_MAX+1];
+    long long value;
+    char * recipe;
+    size_t recipe_size;
+};
+
+/*
+ * Struct of the replication state
+ * @param role - primary, replica, or neither
+ * @param path - the Unix socket
+ * @param epoch - names the primary's run, so a replica never resumes from another run's journal
+ * @param lock - held by the main thread while it serves a request, and by the other threads while they use the inventory
+ * @param changed - signaled when entries are added, for the shipping threads
+ * @param held - set while the main thread holds "lock"
+ * @param journal - the newest JOURNAL_SIZE entries, indexed by seq % JOURNAL_SIZE
+ * @param first_seq - the oldest entry still in "journal"
+ * @param last_seq - the newest entry, 0 before the first
+ * @param signaled_seq - "last_seq" when "changed" was last signaled
+ * @param listen_fd - a primary's listening socket
+ * @param applied_seq - the last entry a replica applied
+ * @param last_contact - when a replica last heard from its primary
+ * @param ready - set once a replica has a snapshot
+ */
+struct replication {
+    enum replication_role role;
+    char * path;
+    char epoch[32];
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int held;
+    struct journal_entry * journal;
+    long first_seq;
+    long last_seq;
+    long signaled_seq;
+    int listen_fd;
+    long applied_seq;
+    struct timespec last_contact;
+    int ready;
+};
+
+int replication_start(enum replication_role role, char * path);
+void replication_stop();
+void replication_hold();
+void replication_release();
+void journal_append(enum journal_kind kind, char * id, long long value, items_needed_t * items);
+void journal_recipe(struct record * record, items_needed_t * items);
+void journal_write(struct record * record, struct journal_entry * entry);
+void journal_snapshot(struct record * record);
+void * replication_accept(void * arg);
+void * replication_ship(void * arg);
+int replication_send(int fd, struct record * record);
+void * replication_receive(void * arg);
+void replica_apply(char * line, long * snapshot_seq);
+int replica_refuses(char * line);
+
+/*
+ * THESE ARE USED FOR REQUEST INPUT
+ * Requests are read by a thread of their own into two INPUT_CHUNK buffers in turn, so the next chunk is read (and
+ * decompressed) while the requests in the current one are served. A request file that starts with the gzip or zstd
+ * magic number is decompressed as it is read, when built with -DINPUT_GZIP (and -lz) or -DINPUT_ZSTD (and -lzstd).
+ * A partition worker's requests come from a socket the partition code also reads, so it keeps using fgets()
+ */
+#define INPUT_CHUNK (1 << 20) // bytes, a power of two
+
+enum input_codec {
+    CODEC_UNKNOWN, // until the first bytes are read
+    CODEC_PLAIN,
+    CODEC_GZIP,
+    CODEC_ZSTD
+};
+
+/*
+ * Struct of the request input
+ * @param fp - the request file
+ * @param fd - its descriptor, read directly unless "direct" is set
+ * @param direct - read with fgets() on the main thread: a partition worker, or no reader thread could be started
+ * @param buffers - filled by the reader thread in turn; the main thread serves requests from "current"
+ * @param lengths - the bytes in each buffer; 0 once the input has ended
+ * @param full - set by the reader thread when a buffer is filled, cleared by the main thread when it is used up
+ * @param holding - set while the main thread is serving requests from "current"
+ * @param position - how far the main thread is into "current"
+ * @param done - set once the reader thread has returned
+ * @param raw - bytes read but not yet decoded, from "raw_start" to "raw_length"
+ * @param raw_ended - set once the request file has no more bytes
+ * @param stream - the decoder, a z_stream or a ZSTD_DStream
+ * @param partial - set while the zstd decoder is partway through a frame
+ * @param ended - set once nothing more can be decoded
+ */
+struct input {
+    FILE * fp;
+    int fd;
+    int direct;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    char * buffers[2];
+    size_t lengths[2];
+    int full[2];
+    int current;
+    int holding;
+    size_t position;
+    int done;
+    enum input_codec codec;
+    char * raw;
+    size_t raw_start;
+    size_t raw_length;
+    int raw_ended;
+    void * stream;
+    int partial;
+    int ended;
+};
+
+void input_open(struct input * input, FILE * fp, int direct);
+char * input_gets(struct input * input, char * line, int size);
+void input_close(struct input * input);
+void * input_read_ahead(void * arg);
+size_t input_fill(struct input * input, char * out);
+int input_magic(struct input * input, const unsigned char * magic, size_t size);
+void input_raw(struct input * input);
+size_t input_decode(struct input * input, char * out);
+
+/*
+ * THESE ARE USED FOR CAPTURE AND REPLAY
+ * --capture=FILE writes each request main() serves to FILE, after the microseconds since the capture started and a tab.
+ * --replay=FILE serves a capture in place of a request file, as fast as it can or, with --paced, at the pace it was
+ * captured, then reports the requests served per second, latency percentiles, and checksums of standard output and
+ * standard error, so two builds can be compared on the same traffic. Both outputs still reach where they were going:
+ * a thread each reads them from a pipe, adds them to the checksum and passes them on. A paced request's latency is
+ * counted from when it was due, so falling behind shows up in it
+ */
+#define CAPTURE_STAMP_MAX 24 // the longest "microseconds<tab>" a captured line starts with
+
+/*
+ * Struct of the capture
+ * @param fp - the capture file, NULL when not capturing
+ * @param start - when the capture started
+ */
+struct capture {
+    FILE * fp;
+    struct timespec start;
+};
+
+/*
+ * Struct of one output passed on by replay_tee()
+ * @param fd - the reading end of the pipe that took the output's place
+ * @param out - where the output was going before
+ * @param checksum - FNV-1a of everything written to it so far
+ */
+struct replay_stream {
+    int fd;
+    int out;
+    pthread_t thread;
+    int started;
+    unsigned long long checksum;
+};
+
+/*
+ * Struct of the replay
+ * @param active - set with --replay
+ * @param paced - set with --paced
+ * @param start - when the first request was served
+ * @param first_stamp - the first captured request's time, which "start" stands for
+ * @param issued - when the request being served was due, or started when not paced
+ * @param in_flight - set from replay_next() until replay_finish() for the same request
+ * @param latencies - nanoseconds, one per request served
+ */
+struct replay {
+    int active;
+    int paced;
+    struct timespec start;
+    long long first_stamp;
+    struct timespec issued;
+    int in_flight;
+    long long * latencies;
+    size_t count;
+    size_t capacity;
+    struct replay_stream streams[2]; // standard output, standard error
+};
+
+int capture_start(char * filename);
+void capture_request(char * request);
+void capture_stop();
+int replay_start();
+char * replay_next(char * line);
+void replay_finish();
+void * replay_tee(void * arg);
+void replay_stop();
+int latency_compare(const void *, const void *);
+
+/*
+ * THESE ARE USED FOR THE CHANGE FEED
+ * Every change to an assembly's on_hand must go through set_on_hand()
+ */
+void set_on_hand(assembly_t * assembly, long long on_hand);
+void feed_flush();
+void feed_reset();
+int is_low(long long on_hand, long long capacity);
+
+/*
+ * THESE ARE USED FOR THE ID INDEXES
+ */
+size_t id_hash(const char * id);
+void * index_lookup(struct id_index * index, const char * id);
+int index_reserve(struct id_index * index, size_t count);
+int index_insert(struct id_index * index, void * entry);
+void index_clear(struct id_index * index);
+
+/*
+ * THESE ARE USED FOR BULK IMPORT
+ */
+
+// one component of an imported recipe
+struct import_component {
+    char id[ID_MAX+1];
+    long long quantity;
+};
+
+// one imported part or assembly
+struct import_record {
+    char id[ID_MAX+1];
+    int line;            // line number in the file
+    long long capacity;  // assemblies only
+    int chunk;           // chunk that parsed this record, owner of its components
+    int first_component; // index of this record's first component in its chunk
+    int component_count;
+};
+
+// a problem found on one line of an imported file
+struct import_error {
+    int line;
+    char message[96];
+};
+
+// one slice of the file, parsed by its own thread
+struct import_chunk {
+    char * start; // first character of the chunk
+    char * end;   // one past the last character; chunks always end on a line boundary
+    int assemblies; // 1 for an assemblies file, 0 for a parts file
+    int line_count;
+    struct import_record * records;
+    int record_count;
+    size_t record_capacity;
+    struct import_component * components;
+    int component_count;
+    size_t component_capacity;
+    struct import_error * errors;
+    int error_count;
+    size_t error_capacity;
+    int failed;   // set if an allocation failed
+};
+
+int worker_count(size_t work, size_t grain);
+char * read_file(char * filename, size_t * size);
+void * import_parse_chunk(void * arg);
+int import_record_compare(const void *, const void *);
+int import_error_compare(const void *, const void *);
+void import_add_error(struct import_chunk * chunk, int line, const char * format, ...);
+int import_load(char * filename, int assemblies, struct import_chunk ** chunks_out, int * chunk_count_out);
+void import_free(struct import_chunk * chunks, int chunk_count);
+char * import_next_field(char ** cursor);
+long long import_number(char * text);
+struct import_record ** import_sorted(struct import_chunk * chunks, int chunk_count, int * count_out);
+int import_report_errors(char * filename, struct import_chunk * chunks, int chunk_count, char * request);
+void import_report_stopped(char * filename, char * kind, int added, int count);
+
+/*
+ * THESE ARE USED FOR CATALOG RELOADS
+ * reloadCatalog hands the file to a builder thread, which puts the new catalog together in an inventory of its own
+ * while requests go on being served from "inv". Before each request the main thread checks whether it is built, and
+ * publishes it there, so every request sees one catalog or the other, never a mix: on_hand, reserved and changed_seq
+ * carry over to assemblies whose IDs are in both, reservations and logged changes move to the new assemblies, and
+ * "inv" becomes the new catalog. Logged changes of assemblies the new catalog dropped still point at them, so those
+ * are retired rather than freed, and reclaimed once the change feed has moved past their last change
+ * @param filename - the catalog file, while a reload is in progress
+ * @param text - the file's contents, cut into lines by the builder
+ * @param text_size - the number of bytes allocated for "text"
+ * @param thread - the builder thread, if "started"
+ * @param started - 0 if the thread couldn't be started, and the catalog was built on the main thread instead
+ * @param building - set from reloadCatalog until the new catalog is published or thrown away
+ * @param built - set by the builder once "next" and "errors" are complete
+ * @param next - the catalog being built
+ * @param errors - the problems found in the file, by line; any one of them cancels the reload
+ * @param retired - assemblies dropped by earlier reloads that the change feed still points at, linked by "next"
+ * @param interactive - set when requests come from a terminal; otherwise each reload is published before the next request
+ */
+struct catalog_reload {
+    char * filename;
+    char * text;
+    size_t text_size;
+    pthread_t thread;
+    int started;
+    int building;
+    int built;
+    inventory_t next;
+    struct import_chunk * errors;
+    assembly_t * retired;
+    int interactive;
+};
+
+void * catalog_build(void * arg);
+void catalog_build_line(inventory_t * invp, struct import_chunk * errors, int line_number, char * line);
+void catalog_poll(int wait);
+void catalog_publish();
+void catalog_discard();
+void catalog_reclaim(int all);
+void catalog_stop();
+
+/*
+ * THESE ARE USED FOR MEMORY ACCOUNTING
+ * Every allocation the inventory makes goes through these, so "memory" can report usage per structure
+ */
+void * mem_alloc(enum mem_kind kind, size_t size);
+void * mem_calloc(enum mem_kind kind, size_t count, size_t size);
+void mem_free(enum mem_kind kind, void * pointer, size_t size);
+int grow_array(enum mem_kind kind, void ** array, size_t * capacity, size_t needed, size_t size, size_t first);
+int mem_over_limit(size_t size);
+size_t mem_overhead(void * pointer, size_t size);
+void mem_account(enum mem_kind kind, void * pointer, size_t size);
+
+// Note: pre-provided "print" functions and "free_inventory()" function were removed; functionality was either directly implemented into other functions, or were renamed to something else
+
 #endif // INVENTORY_H
\ No newline at end of file
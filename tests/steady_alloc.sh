@@ -0,0 +1,19 @@
+#!/bin/sh
+# Checks that fulfillOrder, stock, restock, empty, inventory and parts stop allocating once the inventory has been
+# seen: steady_alloc.txt serves the same round of requests twice, and the "allocations" count reported by "memory"
+# after each round must be the same.
+# usage: tests/steady_alloc.sh [path to the inventory program, ./inventory by default]
+inventory=${1:-./inventory}
+requests="$(dirname "$0")/steady_alloc.txt"
+
+counts=$("$inventory" "$requests" 2>/dev/null | awk '$1 == "allocations" { print $2 }')
+set -- $counts
+if [ $# -ne 2 ]; then
+        echo "steady_alloc: expected two allocation counts, got: $counts" >&2
+        exit 1
+fi
+if [ "$1" != "$2" ]; then
+        echo "steady_alloc: the second round allocated $(($2 - $1)) times" >&2
+        exit 1
+fi
+echo "steady_alloc: ok ($1 allocations after each round)"